@@ -1,4 +1,4 @@
-
+#include <string.h>
 #include <iostream>
 #include <limits>
 
@@ -11,7 +11,7 @@ namespace httplib {
 	//--------------------------------------------------------------------------------------------------------------
 	//--
 
-	ClientRequest::ClientRequest() {
+	ClientRequest::ClientRequest(bool z) : zeroCopy(z), connected(false), coalesceThreshold(0) {
 		clear();
 	}
 
@@ -19,81 +19,232 @@ namespace httplib {
 		transferLeft = 0;
 		expect100 = false;
 		headRequest = false;
+		closeConnection = false;
 		state = SendRequestHeader;
 		transferMode = BodyTransferIdentity;
 
 		resource.clear();
 		extraHeaders.clear();
-		chunkLines.clear();
 
 		responseHdr.clear();
+		responseView.clear();
+		tailViews.clear();
 		responseParser.clear();
 		chunkParser.clear();
 		tailParser.clear();
 	}
 
-	void ClientRequest::beginRequest(const RequestHeader& request, Buffers& buffers, uint64_t knownsize) {
-		if (state != SendRequestHeader)
-			throw HttpError("Out of order call");
+	void ClientRequest::setLimits(const ParserLimits& limits) {
+		responseParser.limits = limits;
+		tailParser.limits = limits;
+	}
+
+	void ClientRequest::setCoalescing(size_t threshold) {
+		coalesceThreshold = threshold;
+	}
+
+	void ClientRequest::emit(const iovec* vec, int c) {
+		if (coalesceThreshold == 0)
+			transmit(vec, c);
+		else {
+			coalesceBuffers(vec, c, coalesceThreshold, coalesceScratch, coalesceParts);
+			if (!coalesceParts.empty())
+				transmit(&coalesceParts[0], coalesceParts.size());
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	static const char userAgentLine[] = "User-Agent: httplib 0.1\r\n";
+	static const char chunkedLine[] = "Transfer-Encoding: chunked\r\n";
+	static const char contentLengthName[] = "Content-Length: ";
+
+	template <size_t N> static iovec lineBuffer(const char (&line)[N]) {
+		iovec r = { (void*)line, N - 1 };
+		return r;
+	}
+
+	PreparedRequest::PreparedRequest() : contentLength(0), headRequest(false), expect100(false),
+		closeConnection(false), haveHost(false), haveUserAgent(false), haveDate(false), haveLength(false),
+		haveChunked(false), haveIdentity(false) {
+	}
+
+	PreparedRequest::PreparedRequest(const RequestHeader& h) {
+		assign(h);
+	}
+
+	void PreparedRequest::assign(const RequestHeader& h) {
+		scan(h);
+		header = h;
+
+		Uri uri(h.uri);
+		string host = uri.authority;
+		uri.scheme.clear();
+		uri.authority.clear();
+		target = h.method + " " + uri.format();
+
+		// The formatted path is escaped, so the first '?' or '#' starts the query.
+		size_t q = target.find_first_of("?#", h.method.size() + 1);
+		query.clear();
+		if (q != string::npos) {
+			query.assign(target, q, string::npos);
+			target.erase(q);
+		}
+
+		block = " HTTP/1.1\r\n";
+		if (!haveHost)
+			block += "Host: " + host + "\r\n";
+		if (!haveUserAgent)
+			block += userAgentLine;
+		for (HttpHeaders::const_iterator i = h.headers.begin(); i != h.headers.end(); ++i)
+			block += i->name + ": " + i->value + "\r\n";
+	}
+
+	void PreparedRequest::scan(const RequestHeader& request) {
+		contentLength = 0;
+		expect100 = false;
+		closeConnection = false;
+		haveHost = false;
+		haveUserAgent = false;
+		haveDate = false;
+		haveLength = false;
+		haveChunked = false;
+		haveIdentity = false;
 
-		bool havehost = false;
-		bool havedate = false;
-		bool havelength = false;
-		bool havechunked = false;
-		bool haveidentity = false;
-		bool haveencoding = false;
-		bool haveuseragent = false;
-		bool have100continue = false;
-		uint64_t contentlength = 0;
 		for (HttpHeaders::const_iterator i = request.headers.begin(); i != request.headers.end(); ++i) {
-			if (iCaseEqual(i->name, "Transfer-Encoding")) {
-				haveencoding = true;
+			switch (lookupHeader(i->name)) {
+			case HeaderTransferEncoding :
 				if (hasCsvValue(i->value.begin(), i->value.end(), "chunked"))
-					havechunked = true;
+					haveChunked = true;
 				if (hasCsvValue(i->value.begin(), i->value.end(), "identity"))
-					haveidentity = true;
-			}
-			else if (iCaseEqual(i->name, "Content-Length")) {
-				if (havelength)
+					haveIdentity = true;
+				break;
+			case HeaderContentLength :
+				if (haveLength)
 					throw HttpError("Duplicate Content-Length header");
-				parseInteger(i->value.begin(), i->value.end(), contentlength);
-				havelength = true;
-			}
-			else if (iCaseEqual(i->name, "User-Agent")) {
-				if (haveuseragent)
+				parseInteger(i->value.begin(), i->value.end(), contentLength);
+				haveLength = true;
+				break;
+			case HeaderUserAgent :
+				if (haveUserAgent)
 					throw HttpError("Duplicate User-Agent header");
-				haveuseragent = true;
-			}
-			else if (iCaseEqual(i->name, "Host")) {
-				if (havehost)
+				haveUserAgent = true;
+				break;
+			case HeaderHost :
+				if (haveHost)
 					throw HttpError("Duplicate Host header");
-				havehost = true;
-			}
-			else if (iCaseEqual(i->name, "Date")) {
-				if (havedate)
+				haveHost = true;
+				break;
+			case HeaderDate :
+				if (haveDate)
 					throw HttpError("Duplicate Date header");
-				havedate = true;
-			}
-			else if (iCaseEqual(i->name, "Expect")) {
+				haveDate = true;
+				break;
+			case HeaderConnection :
+				if (hasCsvValue(i->value.begin(), i->value.end(), "close"))
+					closeConnection = true;
+				break;
+			case HeaderExpect :
 				if (iCaseEqual(i->value, "100-continue"))
-					have100continue = true;
+					expect100 = true;
+				break;
+			default :
+				break;
 			}
 		}
 
-		if ((havelength && havechunked) || (havechunked && haveidentity))
+		if ((haveLength && haveChunked) || (haveChunked && haveIdentity))
 			throw HttpError("Inconsistent Transfer-Encoding headers");
 
-		if (haveidentity && knownsize == ~uint64_t(0) && !havelength)
+		headRequest = lookupMethod(request.method) == MethodHead;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	void ClientRequest::beginRequest(const RequestHeader& request, Buffers& buffers, uint64_t knownsize) {
+		if (state != SendRequestHeader)
+			throw HttpError("Out of order call");
+
+		PreparedRequest t;
+		t.scan(request);
+
+		Uri uri(request.uri);
+
+		if (!t.haveHost)
+			extraHeaders.push_back(HttpHeader("Host", uri.authority));
+
+		uri.scheme.clear();
+		uri.authority.clear();
+		resource = uri.format();
+
+		buffers.clear();
+		buffers.reserve((request.headers.size() + extraHeaders.size()) * 4 + 10);
+		requestLineBuffers(request.method, resource, buffers);
+		toBuffers(extraHeaders, buffers);
+		if (!t.haveUserAgent)
+			buffers.push_back(lineBuffer(userAgentLine));
+		toBuffers(request.headers, buffers);
+		frameRequest(t, buffers, knownsize);
+	}
+
+	void ClientRequest::beginRequest(const PreparedRequest& t, const string& suffix, const HttpHeaders& headers,
+		Buffers& buffers, uint64_t knownsize) {
+		if (state != SendRequestHeader)
+			throw HttpError("Out of order call");
+
+		// The prepared block already has Host, User-Agent and the framing headers, so these may only add
+		// to them.
+		bool close = false;
+		bool expect = false;
+		for (HttpHeaders::const_iterator i = headers.begin(); i != headers.end(); ++i) {
+			switch (lookupHeader(i->name)) {
+			case HeaderHost :
+			case HeaderUserAgent :
+			case HeaderDate :
+			case HeaderContentLength :
+			case HeaderTransferEncoding :
+				throw HttpError("Header " + i->name + " not allowed with a prepared request");
+			case HeaderConnection :
+				if (hasCsvValue(i->value.begin(), i->value.end(), "close"))
+					close = true;
+				break;
+			case HeaderExpect :
+				if (iCaseEqual(i->value, "100-continue"))
+					expect = true;
+				break;
+			default :
+				break;
+			}
+		}
+
+		buffers.clear();
+		buffers.push_back(toBuffer(t.target));
+		if (!suffix.empty())
+			buffers.push_back(toBuffer(suffix));
+		if (!t.query.empty())
+			buffers.push_back(toBuffer(t.query));
+		buffers.push_back(toBuffer(t.block));
+		toBuffers(headers, buffers);
+		frameRequest(t, buffers, knownsize);
+		closeConnection = closeConnection || close;
+		expect100 = expect100 || expect;
+	}
+
+	// Picks the transfer mode for this body and adds the headers that vary between requests.
+	void ClientRequest::frameRequest(const PreparedRequest& t, Buffers& buffers, uint64_t knownsize) {
+		if (t.haveIdentity && knownsize == ~uint64_t(0) && !t.haveLength)
 			throw HttpError("Inconsistent Transfer-Encoding headers");
 
-		if (havelength && knownsize != ~uint64_t(0) && contentlength != knownsize)
+		if (t.haveLength && knownsize != ~uint64_t(0) && t.contentLength != knownsize)
 			throw HttpError("Content-length header doesn't match body size");
 
-		if (!havechunked && havelength) {
+		if (!t.haveChunked && t.haveLength) {
 			transferMode = BodyTransferIdentity;
-			transferLeft = contentlength;
+			transferLeft = t.contentLength;
 		}
-		else if (!havechunked && knownsize != ~uint64_t(0)) {
+		else if (!t.haveChunked && knownsize != ~uint64_t(0)) {
 			transferMode = BodyTransferIdentity;
 			transferLeft = knownsize;
 		}
@@ -102,53 +253,58 @@ namespace httplib {
 			transferLeft = 0;
 		}
 
-		Uri uri(request.uri);
-
-		if (!havehost)
-			extraHeaders.push_back(HttpHeader("Host", uri.authority));
-
-		if (!haveuseragent)
-			extraHeaders.push_back(HttpHeader("User-Agent", "httplib 0.1"));
-
-		if (transferMode == BodyTransferChunked && !havechunked)
-			extraHeaders.push_back(HttpHeader("Transfer-Encoding", "chunked"));
-
-		if (!havedate)
-			extraHeaders.push_back(HttpHeader("Date", dateStr()));
-
-		if (knownsize != ~uint64_t(0) && transferMode == BodyTransferIdentity && !havelength)
-			extraHeaders.push_back(HttpHeader("Content-Length", decSize(transferLeft)));
-
-		uri.scheme.clear();
-		uri.authority.clear();
-		resource = uri.format();
+		if (transferMode == BodyTransferChunked && !t.haveChunked)
+			buffers.push_back(lineBuffer(chunkedLine));
+
+		if (knownsize != ~uint64_t(0) && transferMode == BodyTransferIdentity && !t.haveLength) {
+			char* p = contentLengthLine;
+			memcpy(p, contentLengthName, sizeof(contentLengthName) - 1);
+			p += sizeof(contentLengthName) - 1;
+			p += decSize(transferLeft, p);
+			*p++ = '\r';
+			*p++ = '\n';
+			iovec v = { contentLengthLine, size_t(p - contentLengthLine) };
+			buffers.push_back(v);
+		}
 
-		buffers.reserve((request.headers.size() + extraHeaders.size()) * 4 + 4);
-		requestLineBuffers(request.method, resource, buffers);
-		toBuffers(extraHeaders, buffers);
-		toBuffers(request.headers, buffers);
+		if (!t.haveDate)
+			buffers.push_back(dateLineBuffer());
 		buffers.push_back(blanklineBuffer());
 
-		headRequest = request.method == "HEAD";
-		expect100 = have100continue;
+		if (t.closeConnection)
+			closeConnection = true;
+		headRequest = t.headRequest;
+		expect100 = t.expect100;
 	}
 
-	void ClientRequest::setupResponseBody() {
+	template <typename Response> void ClientRequest::setupResponseBody(const Response& header) {
 		uint64_t contentlength;
 		bool havelength = false;
 		bool havechunked = false;
-		for (HttpHeaders::const_iterator i = responseHdr.headers.begin(); i != responseHdr.headers.end(); ++i) {
-			if (iCaseEqual(i->name, "Transfer-Encoding")) {
+		bool haveclose = false;
+		bool havekeepalive = false;
+		for (typename Response::Headers::const_iterator i = header.headers.begin(); i != header.headers.end(); ++i) {
+			switch (i->id) {
+			case HeaderConnection :
+				if (hasCsvValue(i->value.begin(), i->value.end(), "close"))
+					haveclose = true;
+				if (hasCsvValue(i->value.begin(), i->value.end(), "keep-alive"))
+					havekeepalive = true;
+				break;
+			case HeaderTransferEncoding :
 				if (!iCaseEqual(i->value, "identity"))
 					havechunked = true;
-			}
-			else if (iCaseEqual(i->name, "Content-Length")) {
+				break;
+			case HeaderContentLength :
 				parseInteger(i->value.begin(), i->value.end(), contentlength);
 				havelength = true;
+				break;
+			default :
+				break;
 			}
 		}
 
-		bool mustbeempty = headRequest || responseHdr.code == 204 || responseHdr.code == 304 || responseHdr.code / 100 == 1;
+		bool mustbeempty = headRequest || header.code == 204 || header.code == 304 || header.code / 100 == 1;
 		transferLeft = 0;
 
 		if (mustbeempty) {
@@ -161,16 +317,45 @@ namespace httplib {
 			transferMode = BodyTransferIdentity;
 			transferLeft = havelength ? contentlength : std::numeric_limits<uint64_t>::max();
 		}
+
+		// A body that runs until the connection closes also ends the connection.
+		bool http11 = header.versionmajor > 1 || (header.versionmajor == 1 && header.versionminor >= 1);
+		if (haveclose || (!http11 && !havekeepalive) || transferLeft == std::numeric_limits<uint64_t>::max())
+			closeConnection = true;
+	}
+
+	bool ClientRequest::shouldClose() {
+		return closeConnection;
+	}
+
+	bool ClientRequest::isConnected() {
+		return connected;
+	}
+
+	bool ClientRequest::isFinished() {
+		return state == RequestFinished;
+	}
+
+	void ClientRequest::dropConnection() {
+		if (connected) {
+			connected = false;
+			disconnect();
+		}
+	}
+
+	void ClientRequest::ensureConnected(const RequestHeader& header) {
+		if (!connected) {
+			connect(header);
+			connected = true;
+		}
 	}
 
 	void ClientRequest::request(const RequestHeader& header) {
 		if (state != SendRequestHeader) throw HttpError("can't send request");
 
-		connect(header);
-		Buffers buffers;
-		state = SendRequestBody;
-		beginRequest(header, buffers, ~uint64_t(0));
-		transmit(&buffers[0], buffers.size());
+		ensureConnected(header);
+		beginRequest(header, requestParts, ~uint64_t(0));
+		emit(&requestParts[0], requestParts.size());
 		state = SendRequestBody;
 	}
 
@@ -180,15 +365,19 @@ namespace httplib {
 		uint64_t l = 0;
 		for (int i = 0; i < c; ++i) l += vec[i].iov_len;
 
-		connect(header);
-		Buffers buffers;
-		beginRequest(header, buffers, l);
-		transferLeft -= bodyBuffers(transferMode == BodyTransferChunked, chunkLines, vec, c, buffers);
+		ensureConnected(header);
+		beginRequest(header, requestParts, l);
+		completeRequest(vec, c);
+	}
+
+	// Transmits the framed header in requestParts together with the whole body.
+	void ClientRequest::completeRequest(const iovec* vec, int c) {
+		transferLeft -= bodyBuffers(transferMode == BodyTransferChunked, chunkSize, vec, c, requestParts);
 		if (transferMode == BodyTransferChunked)
-			buffers.push_back(chunkEndBuffer());
+			requestParts.push_back(chunkEndBuffer());
 		else if (transferLeft != 0)
 			throw HttpError("body side doesn't match size header");
-		transmit(&buffers[0], buffers.size());
+		emit(&requestParts[0], requestParts.size());
 		state = RecvResponseHeader;
 	}
 
@@ -202,26 +391,121 @@ namespace httplib {
 		request(header, &v, 1);
 	}
 
+	void ClientRequest::send(const iovec* vec, int c) {
+		if (state != SendRequestBody) throw HttpError("can't send request body");
+
+		if (transferMode == BodyTransferIdentity) {
+			uint64_t l = 0;
+			for (int i = 0; i < c; ++i) l += vec[i].iov_len;
+			if (l > transferLeft)
+				throw HttpError("body longer than specified size");
+			transferLeft -= l;
+			if (l != 0)
+				emit(vec, c);
+			return;
+		}
+
+		requestParts.clear();
+		bodyBuffers(true, chunkSize, vec, c, requestParts);
+		if (!requestParts.empty())
+			emit(&requestParts[0], requestParts.size());
+	}
+
+	void ClientRequest::send(const void * b, int s) {
+		iovec v = { (void*)b, size_t(s) };
+		send(&v, 1);
+	}
+
+	void ClientRequest::send(const string& str) {
+		iovec v = { (void*)&str[0], str.size() };
+		send(&v, 1);
+	}
+
+	void ClientRequest::finish() {
+		if (state != SendRequestBody) throw HttpError("can't finish request body");
+
+		if (transferMode == BodyTransferIdentity) {
+			if (transferLeft != 0)
+				throw HttpError("body size mismatch");
+		}
+		else {
+			iovec v = chunkEndBuffer();
+			emit(&v, 1);
+		}
+		state = RecvResponseHeader;
+	}
+
+	static const HttpHeaders noHeaders;
+
+	void ClientRequest::request(const PreparedRequest& prepared, const string& suffix, const HttpHeaders& headers) {
+		if (state != SendRequestHeader) throw HttpError("can't send request");
+
+		ensureConnected(prepared.header);
+		beginRequest(prepared, suffix, headers, requestParts, ~uint64_t(0));
+		emit(&requestParts[0], requestParts.size());
+		state = SendRequestBody;
+	}
+
+	void ClientRequest::request(const PreparedRequest& prepared, const string& suffix, const HttpHeaders& headers,
+		const iovec* vec, int c) {
+		if (state != SendRequestHeader) throw HttpError("can't send request");
+
+		uint64_t l = 0;
+		for (int i = 0; i < c; ++i) l += vec[i].iov_len;
+
+		ensureConnected(prepared.header);
+		beginRequest(prepared, suffix, headers, requestParts, l);
+		completeRequest(vec, c);
+	}
+
+	void ClientRequest::request(const PreparedRequest& prepared) {
+		request(prepared, string(), noHeaders);
+	}
+
+	void ClientRequest::request(const PreparedRequest& prepared, const iovec* vec, int c) {
+		request(prepared, string(), noHeaders, vec, c);
+	}
+
+	void ClientRequest::request(const PreparedRequest& prepared, const char * b, int s) {
+		iovec v = { (void*)b, size_t(s) };
+		request(prepared, string(), noHeaders, &v, 1);
+	}
+
+	void ClientRequest::request(const PreparedRequest& prepared, const string& str) {
+		iovec v = { (void*)&str[0], str.size() };
+		request(prepared, string(), noHeaders, &v, 1);
+	}
+
 	int ClientRequest::feed(const char *f, int s) {
 		const char *b = f;
 		const char *e = f + s;
 		while (b != e && state == RecvResponseHeader) {
-			b = responseParser.parse(b, e, responseHdr);
+			b = zeroCopy ? responseParser.parse(b, e, responseView) : responseParser.parse(b, e, responseHdr);
+			if (responseParser.isBad() && responseParser.parseError() == ParseHeaderTooLarge)
+				throw HttpError("Response header too large");
 			if (responseParser.isBad())
 				throw HttpError("Invalid response header");
 
 			if (responseParser.isDone()) {
-				if (expect100 && responseHdr.code == 100) {
+				if (expect100 && (zeroCopy ? responseView.code : responseHdr.code) == 100) {
 					expect100 = false;
 					responseHdr.clear();
+					responseView.clear();
 					responseParser.clear();
 					continue100();
 					continue;
 				}
 
-				setupResponseBody();
-				state = RecvResponseBody;
-				response(responseHdr);
+				if (zeroCopy) {
+					setupResponseBody(responseView);
+					state = RecvResponseBody;
+					response(responseView);
+				}
+				else {
+					setupResponseBody(responseHdr);
+					state = RecvResponseBody;
+					response(responseHdr);
+				}
 			}
 		}
 
@@ -240,6 +524,8 @@ namespace httplib {
 			else if (b != e) {
 				if (!chunkParser.isDone()) {
 					b = chunkParser.parse(b, e, transferLeft);
+					if (chunkParser.isBad())
+						throw HttpError("Invalid chunk header");
 					if (!chunkParser.isDone()) break;
 					if (transferLeft == 0) {
 						state = RecvTailHeaders;
@@ -251,7 +537,7 @@ namespace httplib {
 				transferLeft -= l;
 				b += l;
 				if (transferLeft == 0)
-					chunkParser.clear();
+					chunkParser.nextChunk();
 				recv(b - l, l);
 			}
 			if (b == e)
@@ -259,7 +545,9 @@ namespace httplib {
 		}
 
 		while (b != e && state == RecvTailHeaders) {
-			b = tailParser.parse(b, e, responseHdr.headers);
+			b = zeroCopy ? tailParser.parse(b, e, tailViews) : tailParser.parse(b, e, responseHdr.headers);
+			if (tailParser.isBad())
+				throw HttpError("Invalid trailer");
 			if (tailParser.isDone()) {
 				state = RequestFinished;
 				end();
@@ -10,16 +10,66 @@
 
 namespace httplib {
 
+	//---------------------------------------------------------------------------------------------------------
+	//-- A request target and header validated and serialized once, for clients that send many requests to
+	//-- the same endpoint.  Each request may add a path suffix, a few headers and its body; the framing and
+	//-- Date lines are added per request as for any other.
+
+	struct PreparedRequest {
+		PreparedRequest();
+		explicit PreparedRequest(const RequestHeader& header);
+
+		void assign(const RequestHeader& header);
+
+		// Reads the flags below from the headers and checks what doesn't depend on the body.
+		void scan(const RequestHeader& header);
+
+		RequestHeader header;		// as given, for connect()
+		uint64_t contentLength;
+		bool headRequest;
+		bool expect100;
+		bool closeConnection;
+		bool haveHost;
+		bool haveUserAgent;
+		bool haveDate;
+		bool haveLength;
+		bool haveChunked;
+		bool haveIdentity;
+
+		// The request line up to where a suffix goes, its query, then the rest of it with Host and
+		// User-Agent unless given and the headers.
+		string target;
+		string query;
+		string block;
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//--
+
 	struct ClientRequest {
 
-		ClientRequest();
+		explicit ClientRequest(bool zeroCopy = false);
+		virtual ~ClientRequest() {}
 
 		void clear();
+		void setLimits(const ParserLimits& limits);
+
+		// As ServerRequest::setCoalescing(): request lines, headers and body segments shorter than threshold
+		// go to transmit() copied together; 0, the default, passes them as they are.
+		void setCoalescing(size_t threshold);
 
 		int feed(const char * b, int s);
+
+		// connect() runs before the first request and again after dropConnection(), so a connection that is
+		// kept alive carries any number of requests.  disconnect() is the transport's chance to close it.
 		virtual void connect(const RequestHeader& header) {};
+		virtual void disconnect() {}
 		virtual void transmit(const iovec* vec, int c) = 0;
 
+		bool isConnected();
+		bool isFinished();
+		void dropConnection();
+
 		void request(const RequestHeader& header);
 		void send(const iovec* vec, int c);
 		void send(const void * b, int s);
@@ -30,11 +80,27 @@ namespace httplib {
 		void request(const RequestHeader& header, const char * b, int s);
 		void request(const RequestHeader& header, const string& str);
 
+		// suffix goes as it is between the prepared path and its query, so it has to be escaped already.
+		// headers can't repeat Host, User-Agent, Date or the framing headers.
+		void request(const PreparedRequest& prepared, const string& suffix, const HttpHeaders& headers);
+		void request(const PreparedRequest& prepared, const string& suffix, const HttpHeaders& headers,
+			const iovec* vec, int c);
+		void request(const PreparedRequest& prepared);
+		void request(const PreparedRequest& prepared, const iovec* vec, int c);
+		void request(const PreparedRequest& prepared, const char * b, int s);
+		void request(const PreparedRequest& prepared, const string& str);
+
 		virtual void continue100() {}
 		virtual void response(const ResponseHeader& header) {}
+		virtual void response(const ResponseHeaderView& header) {}
 		virtual void recv(const void * b, int s) {}
 		virtual void end() {}
 
+		// In zero copy mode the trailers of a chunked response body, valid during end(); in copy mode they
+		// are appended to the headers response() was given.
+		const HeaderViews& trailers() const { return tailViews; }
+
+		// True when the connection can't carry another request once this response has been received.
 		bool shouldClose();
 
 	private :
@@ -48,20 +114,39 @@ namespace httplib {
 			RequestFinished,
 		};
 
+		void ensureConnected(const RequestHeader& header);
 		void beginRequest(const RequestHeader& request, Buffers& buffers, uint64_t knownsize = ~int64_t(0));
-		void setupResponseBody();
-
+		void beginRequest(const PreparedRequest& t, const string& suffix, const HttpHeaders& headers,
+			Buffers& buffers, uint64_t knownsize);
+		void frameRequest(const PreparedRequest& t, Buffers& buffers, uint64_t knownsize);
+		void completeRequest(const iovec* vec, int c);
+		template <typename Response> void setupResponseBody(const Response& header);
+		void emit(const iovec* vec, int c);
+
+		bool zeroCopy;
+		bool connected;
 		bool expect100;
 		bool headRequest;
+		bool closeConnection;
 		RequestState state;
 		BodyTransferMode transferMode;
 		uint64_t transferLeft;
 
 		string resource;
 		HttpHeaders extraHeaders;
-		list<string> chunkLines;
+		char contentLengthLine[40];
+
+		// Request header and body framing, reused from one request to the next.
+		Buffers requestParts;
+		char chunkSize[16];
+
+		size_t coalesceThreshold;
+		vector<char> coalesceScratch;
+		Buffers coalesceParts;
 
 		ResponseHeader responseHdr;
+		ResponseHeaderView responseView;
+		HeaderViews tailViews;
 		ResponseParser responseParser;
 		ChunkParser chunkParser;
 		TailParser tailParser;
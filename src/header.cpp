@@ -1,5 +1,11 @@
 
+#include <time.h>
+#include <string.h>
+
+#include <algorithm>
+
 #include "header.h"
+#include "parser.h"
 
 namespace httplib {
 
@@ -13,11 +19,425 @@ namespace httplib {
 
 	} // namespace strings
 
+	//---------------------------------------------------------------------------------------------------------
+	//--
+
+	bool operator==(const StringRef& l, const StringRef& r) {
+		return l.size() == r.size() && (l.empty() || memcmp(l.data(), r.data(), l.size()) == 0);
+	}
+
+	Arena::~Arena() {
+		for (size_t i = 0; i < blocks.size(); ++i)
+			delete[] blocks[i];
+	}
+
+	void Arena::clear() {
+		// Keep the first block for the next message; bigger ones only come from unusually large headers.
+		for (size_t i = 1; i < blocks.size(); ++i)
+			delete[] blocks[i];
+		blocks.resize(std::min(blocks.size(), size_t(1)));
+		sizes.resize(blocks.size());
+		block = 0;
+		cur = blocks.empty() ? 0 : blocks[0];
+		last = blocks.empty() ? 0 : blocks[0] + sizes[0];
+	}
+
+	void Arena::swap(Arena& o) {
+		blocks.swap(o.blocks);
+		sizes.swap(o.sizes);
+		std::swap(block, o.block);
+		std::swap(cur, o.cur);
+		std::swap(last, o.last);
+	}
+
+	void Arena::reserve(size_t n) {
+		while (size_t(last - cur) < n) {
+			if (cur != 0 && block + 1 < blocks.size()) {
+				++block;
+			}
+			else {
+				size_t size = std::max(size_t(4096), n * 2);
+				blocks.push_back(new char[size]);
+				sizes.push_back(size);
+				block = blocks.size() - 1;
+			}
+			cur = blocks[block];
+			last = blocks[block] + sizes[block];
+		}
+	}
+
+	void Arena::append(StringRef& ref, const char* b, size_t n) {
+		if (ref.end() == cur && size_t(last - cur) >= n) {
+			memcpy(cur, b, n);
+			cur += n;
+			ref.len += n;
+			return;
+		}
+
+		reserve(ref.size() + n);
+		if (!ref.empty())
+			memcpy(cur, ref.data(), ref.size());
+		memcpy(cur + ref.size(), b, n);
+		ref = StringRef(cur, ref.size() + n);
+		cur += ref.size();
+	}
+
+	void Arena::pin(StringRef& ref, const char* b, const char* e) {
+		if (ref.data() >= b && ref.data() < e) {
+			StringRef r = ref;
+			ref.clear();
+			append(ref, r.data(), r.size());
+		}
+	}
+
+
+	//---------------------------------------------------------------------------------------------------------
+	//--
+
 	template <size_t N> iovec toBuffer(const char (&b)[N]) {
 		iovec r = { (void*)b, N };
 		return r;
 	}
 
+	static bool headerIs(const char* b, size_t n, const char* name) {
+		for (size_t i = 0; i < n; ++i)
+			if (!chartype::iCaseEqual(b[i], name[i])) return false;
+		return true;
+	}
+
+	HeaderId lookupHeader(const char* b, size_t n) {
+		switch (n) {
+		case 2 :
+			switch (chartype::toLower(b[0])) {
+			case 't' :
+				if (headerIs(b, n, "TE")) return HeaderTe;
+				break;
+			}
+			break;
+		case 3 :
+			switch (chartype::toLower(b[0])) {
+			case 'a' :
+				if (headerIs(b, n, "Age")) return HeaderAge;
+				break;
+			case 'v' :
+				if (headerIs(b, n, "Via")) return HeaderVia;
+				break;
+			}
+			break;
+		case 4 :
+			switch (chartype::toLower(b[0])) {
+			case 'd' :
+				if (headerIs(b, n, "Date")) return HeaderDate;
+				break;
+			case 'e' :
+				if (headerIs(b, n, "ETag")) return HeaderETag;
+				break;
+			case 'f' :
+				if (headerIs(b, n, "From")) return HeaderFrom;
+				break;
+			case 'h' :
+				if (headerIs(b, n, "Host")) return HeaderHost;
+				break;
+			case 'v' :
+				if (headerIs(b, n, "Vary")) return HeaderVary;
+				break;
+			}
+			break;
+		case 5 :
+			switch (chartype::toLower(b[0])) {
+			case 'a' :
+				if (headerIs(b, n, "Allow")) return HeaderAllow;
+				break;
+			case 'r' :
+				if (headerIs(b, n, "Range")) return HeaderRange;
+				break;
+			}
+			break;
+		case 6 :
+			switch (chartype::toLower(b[0])) {
+			case 'a' :
+				if (headerIs(b, n, "Accept")) return HeaderAccept;
+				break;
+			case 'c' :
+				if (headerIs(b, n, "Cookie")) return HeaderCookie;
+				break;
+			case 'e' :
+				if (headerIs(b, n, "Expect")) return HeaderExpect;
+				break;
+			case 'o' :
+				if (headerIs(b, n, "Origin")) return HeaderOrigin;
+				break;
+			case 'p' :
+				if (headerIs(b, n, "Pragma")) return HeaderPragma;
+				break;
+			case 's' :
+				if (headerIs(b, n, "Server")) return HeaderServer;
+				break;
+			}
+			break;
+		case 7 :
+			switch (chartype::toLower(b[0])) {
+			case 'e' :
+				if (headerIs(b, n, "Expires")) return HeaderExpires;
+				break;
+			case 'r' :
+				if (headerIs(b, n, "Referer")) return HeaderReferer;
+				break;
+			case 't' :
+				if (headerIs(b, n, "Trailer")) return HeaderTrailer;
+				break;
+			case 'u' :
+				if (headerIs(b, n, "Upgrade")) return HeaderUpgrade;
+				break;
+			case 'w' :
+				if (headerIs(b, n, "Warning")) return HeaderWarning;
+				break;
+			}
+			break;
+		case 8 :
+			switch (chartype::toLower(b[0])) {
+			case 'i' :
+				if (headerIs(b, n, "If-Match")) return HeaderIfMatch;
+				if (headerIs(b, n, "If-Range")) return HeaderIfRange;
+				break;
+			case 'l' :
+				if (headerIs(b, n, "Location")) return HeaderLocation;
+				break;
+			}
+			break;
+		case 10 :
+			switch (chartype::toLower(b[0])) {
+			case 'c' :
+				if (headerIs(b, n, "Connection")) return HeaderConnection;
+				break;
+			case 'k' :
+				if (headerIs(b, n, "Keep-Alive")) return HeaderKeepAlive;
+				break;
+			case 's' :
+				if (headerIs(b, n, "Set-Cookie")) return HeaderSetCookie;
+				break;
+			case 'u' :
+				if (headerIs(b, n, "User-Agent")) return HeaderUserAgent;
+				break;
+			}
+			break;
+		case 11 :
+			switch (chartype::toLower(b[0])) {
+			case 'c' :
+				if (headerIs(b, n, "Content-MD5")) return HeaderContentMD5;
+				break;
+			case 'r' :
+				if (headerIs(b, n, "Retry-After")) return HeaderRetryAfter;
+				break;
+			}
+			break;
+		case 12 :
+			switch (chartype::toLower(b[0])) {
+			case 'c' :
+				if (headerIs(b, n, "Content-Type")) return HeaderContentType;
+				break;
+			case 'm' :
+				if (headerIs(b, n, "Max-Forwards")) return HeaderMaxForwards;
+				break;
+			}
+			break;
+		case 13 :
+			switch (chartype::toLower(b[0])) {
+			case 'a' :
+				if (headerIs(b, n, "Accept-Ranges")) return HeaderAcceptRanges;
+				if (headerIs(b, n, "Authorization")) return HeaderAuthorization;
+				break;
+			case 'c' :
+				if (headerIs(b, n, "Cache-Control")) return HeaderCacheControl;
+				if (headerIs(b, n, "Content-Range")) return HeaderContentRange;
+				break;
+			case 'i' :
+				if (headerIs(b, n, "If-None-Match")) return HeaderIfNoneMatch;
+				break;
+			case 'l' :
+				if (headerIs(b, n, "Last-Modified")) return HeaderLastModified;
+				break;
+			}
+			break;
+		case 14 :
+			switch (chartype::toLower(b[0])) {
+			case 'a' :
+				if (headerIs(b, n, "Accept-Charset")) return HeaderAcceptCharset;
+				break;
+			case 'c' :
+				if (headerIs(b, n, "Content-Length")) return HeaderContentLength;
+				break;
+			}
+			break;
+		case 15 :
+			switch (chartype::toLower(b[0])) {
+			case 'a' :
+				if (headerIs(b, n, "Accept-Encoding")) return HeaderAcceptEncoding;
+				if (headerIs(b, n, "Accept-Language")) return HeaderAcceptLanguage;
+				break;
+			}
+			break;
+		case 16 :
+			switch (chartype::toLower(b[0])) {
+			case 'c' :
+				if (headerIs(b, n, "Content-Encoding")) return HeaderContentEncoding;
+				if (headerIs(b, n, "Content-Language")) return HeaderContentLanguage;
+				if (headerIs(b, n, "Content-Location")) return HeaderContentLocation;
+				break;
+			case 'w' :
+				if (headerIs(b, n, "WWW-Authenticate")) return HeaderWwwAuthenticate;
+				break;
+			}
+			break;
+		case 17 :
+			switch (chartype::toLower(b[0])) {
+			case 'i' :
+				if (headerIs(b, n, "If-Modified-Since")) return HeaderIfModifiedSince;
+				break;
+			case 't' :
+				if (headerIs(b, n, "Transfer-Encoding")) return HeaderTransferEncoding;
+				break;
+			}
+			break;
+		case 18 :
+			switch (chartype::toLower(b[0])) {
+			case 'p' :
+				if (headerIs(b, n, "Proxy-Authenticate")) return HeaderProxyAuthenticate;
+				break;
+			}
+			break;
+		case 19 :
+			switch (chartype::toLower(b[0])) {
+			case 'i' :
+				if (headerIs(b, n, "If-Unmodified-Since")) return HeaderIfUnmodifiedSince;
+				break;
+			case 'p' :
+				if (headerIs(b, n, "Proxy-Authorization")) return HeaderProxyAuthorization;
+				break;
+			}
+			break;
+		}
+		return HeaderOther;
+	}
+
+	const char* headerName(HeaderId id) {
+		static const char* names[HeaderIdCount] = {
+			"",
+			"Accept",
+			"Accept-Charset",
+			"Accept-Encoding",
+			"Accept-Language",
+			"Accept-Ranges",
+			"Age",
+			"Allow",
+			"Authorization",
+			"Cache-Control",
+			"Connection",
+			"Content-Encoding",
+			"Content-Language",
+			"Content-Length",
+			"Content-Location",
+			"Content-MD5",
+			"Content-Range",
+			"Content-Type",
+			"Cookie",
+			"Date",
+			"ETag",
+			"Expect",
+			"Expires",
+			"From",
+			"Host",
+			"If-Match",
+			"If-Modified-Since",
+			"If-None-Match",
+			"If-Range",
+			"If-Unmodified-Since",
+			"Keep-Alive",
+			"Last-Modified",
+			"Location",
+			"Max-Forwards",
+			"Origin",
+			"Pragma",
+			"Proxy-Authenticate",
+			"Proxy-Authorization",
+			"Range",
+			"Referer",
+			"Retry-After",
+			"Server",
+			"Set-Cookie",
+			"TE",
+			"Trailer",
+			"Transfer-Encoding",
+			"Upgrade",
+			"User-Agent",
+			"Vary",
+			"Via",
+			"Warning",
+			"WWW-Authenticate",
+		};
+		return id < HeaderIdCount ? names[id] : "";
+	}
+
+	HttpMethod lookupMethod(const char* b, size_t n) {
+		switch (n) {
+		case 3 :
+			if (memcmp(b, "GET", 3) == 0) return MethodGet;
+			if (memcmp(b, "PUT", 3) == 0) return MethodPut;
+			break;
+		case 4 :
+			if (memcmp(b, "POST", 4) == 0) return MethodPost;
+			if (memcmp(b, "HEAD", 4) == 0) return MethodHead;
+			break;
+		case 5 :
+			if (memcmp(b, "PATCH", 5) == 0) return MethodPatch;
+			if (memcmp(b, "TRACE", 5) == 0) return MethodTrace;
+			break;
+		case 6 :
+			if (memcmp(b, "DELETE", 6) == 0) return MethodDelete;
+			break;
+		case 7 :
+			if (memcmp(b, "OPTIONS", 7) == 0) return MethodOptions;
+			if (memcmp(b, "CONNECT", 7) == 0) return MethodConnect;
+			break;
+		}
+		return MethodOther;
+	}
+
+	const char* methodName(HttpMethod method) {
+		static const char* names[MethodCount] = {
+			"", "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS", "CONNECT", "TRACE"
+		};
+		return method < MethodCount ? names[method] : "";
+	}
+
+	string getHeaderValue(const HttpHeaders& headers, HeaderId id) {
+		for (HttpHeaders::const_iterator i = headers.begin(); i != headers.end(); ++i)
+			if (i->id == id)
+				return i->value;
+		return string();
+	}
+
+	StringRef getHeaderValue(const HeaderViews& headers, HeaderId id) {
+		for (HeaderViews::const_iterator i = headers.begin(); i != headers.end(); ++i)
+			if (i->id == id)
+				return i->value;
+		return StringRef();
+	}
+
+	string getHeaderValue(const HttpHeaders& headers, const string& tag) {
+		for (HttpHeaders::const_iterator i = headers.begin(); i != headers.end(); ++i)
+			if (iCaseEqual(i->name, tag))
+				return i->value;
+		return string();
+	}
+
+	StringRef getHeaderValue(const HeaderViews& headers, const char* tag) {
+		for (HeaderViews::const_iterator i = headers.begin(); i != headers.end(); ++i)
+			if (iCaseEqual(i->name, tag))
+				return i->value;
+		return StringRef();
+	}
+
 	void toBuffers(const HttpHeader& o, Buffers& buffers) {
 		buffers.push_back(toBuffer(o.name));
 		buffers.push_back(toBuffer(strings::seperator));
@@ -37,6 +457,36 @@ namespace httplib {
 		buffers.push_back(toBuffer(strings::requestend));
 	}
 
+	void coalesceBuffers(const iovec* vec, int c, size_t threshold, vector<char>& scratch, Buffers& out) {
+		size_t small = 0;
+		for (int i = 0; i < c; ++i)
+			if (vec[i].iov_len < threshold)
+				small += vec[i].iov_len;
+		if (scratch.size() < small)
+			scratch.resize(small);
+
+		out.clear();
+		char* p = small != 0 ? &scratch[0] : 0;
+		bool run = false;
+		for (int i = 0; i < c; ++i) {
+			if (vec[i].iov_len >= threshold) {
+				out.push_back(vec[i]);
+				run = false;
+			}
+			else if (vec[i].iov_len != 0) {
+				memcpy(p, vec[i].iov_base, vec[i].iov_len);
+				if (run)
+					out.back().iov_len += vec[i].iov_len;
+				else {
+					iovec v = { p, vec[i].iov_len };
+					out.push_back(v);
+					run = true;
+				}
+				p += vec[i].iov_len;
+			}
+		}
+	}
+
 	iovec blanklineBuffer() {
 		return toBuffer(strings::lineend);
 	}
@@ -45,6 +495,26 @@ namespace httplib {
 		return toBuffer(strings::chunkend);
 	}
 
+	// Formatted at most once a second by each thread.  __thread keeps it lock-free and C++03 friendly.
+	struct DateLine {
+		time_t second;
+		char text[6 + dateLength + 2];
+	};
+
+	static __thread DateLine dateLine = { -1, { 'D', 'a', 't', 'e', ':', ' ' } };
+
+	iovec dateLineBuffer() {
+		time_t second = time(0);
+		if (second != dateLine.second) {
+			dateStr(second, dateLine.text + 6);
+			dateLine.text[6 + dateLength] = '\r';
+			dateLine.text[6 + dateLength + 1] = '\n';
+			dateLine.second = second;
+		}
+		iovec r = { dateLine.text, sizeof(dateLine.text) };
+		return r;
+	}
+
 	const char *responseCodePhrase(int code) {
 		switch (code) {
 			case 100 : return "Continue";
@@ -81,6 +551,7 @@ namespace httplib {
 			case 415 : return "Unsupported Media Type";
 			case 416 : return "Requested range not satisfiable";
 			case 417 : return "Expectation Failed";
+			case 431 : return "Request Header Fields Too Large";
 			case 500 : return "Internal Server Error";
 			case 501 : return "Not Implemented";
 			case 502 : return "Bad Gateway";
@@ -91,4 +562,59 @@ namespace httplib {
 		}
 	}
 
+	template <size_t N> static iovec statusLine(const char (&line)[N]) {
+		iovec r = { (void*)line, N - 1 };
+		return r;
+	}
+
+	iovec statusLineBuffer(int code) {
+		switch (code) {
+			case 100 : return statusLine("HTTP/1.1 100 Continue\r\n");
+			case 101 : return statusLine("HTTP/1.1 101 Switching Protocols\r\n");
+			case 200 : return statusLine("HTTP/1.1 200 OK\r\n");
+			case 201 : return statusLine("HTTP/1.1 201 Created\r\n");
+			case 202 : return statusLine("HTTP/1.1 202 Accepted\r\n");
+			case 203 : return statusLine("HTTP/1.1 203 Non-Authoritative Information\r\n");
+			case 204 : return statusLine("HTTP/1.1 204 No Content\r\n");
+			case 205 : return statusLine("HTTP/1.1 205 Reset Content\r\n");
+			case 206 : return statusLine("HTTP/1.1 206 Partial Content\r\n");
+			case 300 : return statusLine("HTTP/1.1 300 Multiple Choices\r\n");
+			case 301 : return statusLine("HTTP/1.1 301 Moved Permanently\r\n");
+			case 302 : return statusLine("HTTP/1.1 302 Found\r\n");
+			case 303 : return statusLine("HTTP/1.1 303 See Other\r\n");
+			case 304 : return statusLine("HTTP/1.1 304 Not Modified\r\n");
+			case 305 : return statusLine("HTTP/1.1 305 Use Proxy\r\n");
+			case 307 : return statusLine("HTTP/1.1 307 Temporary Redirect\r\n");
+			case 400 : return statusLine("HTTP/1.1 400 Bad Request\r\n");
+			case 401 : return statusLine("HTTP/1.1 401 Unauthorized\r\n");
+			case 402 : return statusLine("HTTP/1.1 402 Payment Required\r\n");
+			case 403 : return statusLine("HTTP/1.1 403 Forbidden\r\n");
+			case 404 : return statusLine("HTTP/1.1 404 Not Found\r\n");
+			case 405 : return statusLine("HTTP/1.1 405 Method Not Allowed\r\n");
+			case 406 : return statusLine("HTTP/1.1 406 Not Acceptable\r\n");
+			case 407 : return statusLine("HTTP/1.1 407 Proxy Authentication Required\r\n");
+			case 408 : return statusLine("HTTP/1.1 408 Request Time-out\r\n");
+			case 409 : return statusLine("HTTP/1.1 409 Conflict\r\n");
+			case 410 : return statusLine("HTTP/1.1 410 Gone\r\n");
+			case 411 : return statusLine("HTTP/1.1 411 Length Required\r\n");
+			case 412 : return statusLine("HTTP/1.1 412 Precondition Failed\r\n");
+			case 413 : return statusLine("HTTP/1.1 413 Request Entity Too Large\r\n");
+			case 414 : return statusLine("HTTP/1.1 414 Request-URI Too Large\r\n");
+			case 415 : return statusLine("HTTP/1.1 415 Unsupported Media Type\r\n");
+			case 416 : return statusLine("HTTP/1.1 416 Requested range not satisfiable\r\n");
+			case 417 : return statusLine("HTTP/1.1 417 Expectation Failed\r\n");
+			case 431 : return statusLine("HTTP/1.1 431 Request Header Fields Too Large\r\n");
+			case 500 : return statusLine("HTTP/1.1 500 Internal Server Error\r\n");
+			case 501 : return statusLine("HTTP/1.1 501 Not Implemented\r\n");
+			case 502 : return statusLine("HTTP/1.1 502 Bad Gateway\r\n");
+			case 503 : return statusLine("HTTP/1.1 503 Service Unavailable\r\n");
+			case 504 : return statusLine("HTTP/1.1 504 Gateway Time-out\r\n");
+			case 505 : return statusLine("HTTP/1.1 505 HTTP Version not supported\r\n");
+			default : {
+				iovec r = { 0, 0 };
+				return r;
+			}
+		}
+	}
+
 } // namespace httplib
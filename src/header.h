@@ -1,37 +1,265 @@
 #ifndef httplib_src_header_h
 #define httplib_src_header_h
 
+#include <string.h>
 #include <sys/uio.h>
 
+#include <new>
+#include <iterator>
+#include <algorithm>
+
 #include "httplib.h"
 
 namespace httplib {
 
+	//---------------------------------------------------------------------------------------------------------
+	//-- Contiguous header list.  The first N entries live inside the object, after that the table moves to
+	//-- the heap.  clear() keeps the entries constructed so their string buffers get reused by the next
+	//-- message on the connection.
+
+	template <typename T, size_t N = 16> struct HeaderTable {
+		typedef T value_type;
+		typedef T* iterator;
+		typedef const T* const_iterator;
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+		HeaderTable() : items(local()), count(0), built(0), capacity(N) {}
+		HeaderTable(const HeaderTable& o) : items(local()), count(0), built(0), capacity(N) { assign(o); }
+		~HeaderTable() { destroy(); }
+
+		HeaderTable& operator=(const HeaderTable& o) {
+			if (this != &o)
+				assign(o);
+			return *this;
+		}
+
+		iterator begin() { return items; }
+		iterator end() { return items + count; }
+		const_iterator begin() const { return items; }
+		const_iterator end() const { return items + count; }
+		reverse_iterator rbegin() { return reverse_iterator(end()); }
+		reverse_iterator rend() { return reverse_iterator(begin()); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+
+		T& operator[](size_t i) { return items[i]; }
+		const T& operator[](size_t i) const { return items[i]; }
+		T& front() { return items[0]; }
+		const T& front() const { return items[0]; }
+		T& back() { return items[count - 1]; }
+		const T& back() const { return items[count - 1]; }
+
+		void push_back(const T& v) {
+			if (count == built) {
+				if (built == capacity)
+					grow();
+				new (items + built) T(v);
+				++built;
+			}
+			else {
+				items[count] = v;
+			}
+			++count;
+		}
+
+		void pop_back() {
+			--count;
+		}
+
+		void clear() {
+			count = 0;
+		}
+
+		void swap(HeaderTable& o) {
+			if (items != local() && o.items != o.local()) {
+				std::swap(items, o.items);
+				std::swap(count, o.count);
+				std::swap(built, o.built);
+				std::swap(capacity, o.capacity);
+			}
+			else {
+				HeaderTable t(*this);
+				assign(o);
+				o.assign(t);
+			}
+		}
+
+	private :
+
+		T* local() {
+			return reinterpret_cast<T*>(storage.bytes);
+		}
+
+		void assign(const HeaderTable& o) {
+			clear();
+			for (size_t i = 0; i < o.count; ++i)
+				push_back(o.items[i]);
+		}
+
+		void grow() {
+			T* p = static_cast<T*>(::operator new(capacity * 2 * sizeof(T)));
+			for (size_t i = 0; i < built; ++i) {
+				new (p + i) T();
+				std::swap(p[i], items[i]);
+				items[i].~T();
+			}
+			if (items != local())
+				::operator delete(items);
+			items = p;
+			capacity *= 2;
+		}
+
+		void destroy() {
+			for (size_t i = 0; i < built; ++i)
+				items[i].~T();
+			if (items != local())
+				::operator delete(items);
+		}
+
+		union {
+			char bytes[N * sizeof(T)];
+			void* aligner;
+			uint64_t aligner64;
+			double alignerd;
+		} storage;
+
+		T* items;
+		size_t count;
+		size_t built;
+		size_t capacity;
+	};
+
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Well known header names.  The parsers tag each header with its id as the name is read so the body
+	//-- setup code (and handlers) can switch on it rather than compare strings.
+
+	enum HeaderId {
+		HeaderOther,
+		HeaderAccept,
+		HeaderAcceptCharset,
+		HeaderAcceptEncoding,
+		HeaderAcceptLanguage,
+		HeaderAcceptRanges,
+		HeaderAge,
+		HeaderAllow,
+		HeaderAuthorization,
+		HeaderCacheControl,
+		HeaderConnection,
+		HeaderContentEncoding,
+		HeaderContentLanguage,
+		HeaderContentLength,
+		HeaderContentLocation,
+		HeaderContentMD5,
+		HeaderContentRange,
+		HeaderContentType,
+		HeaderCookie,
+		HeaderDate,
+		HeaderETag,
+		HeaderExpect,
+		HeaderExpires,
+		HeaderFrom,
+		HeaderHost,
+		HeaderIfMatch,
+		HeaderIfModifiedSince,
+		HeaderIfNoneMatch,
+		HeaderIfRange,
+		HeaderIfUnmodifiedSince,
+		HeaderKeepAlive,
+		HeaderLastModified,
+		HeaderLocation,
+		HeaderMaxForwards,
+		HeaderOrigin,
+		HeaderPragma,
+		HeaderProxyAuthenticate,
+		HeaderProxyAuthorization,
+		HeaderRange,
+		HeaderReferer,
+		HeaderRetryAfter,
+		HeaderServer,
+		HeaderSetCookie,
+		HeaderTe,
+		HeaderTrailer,
+		HeaderTransferEncoding,
+		HeaderUpgrade,
+		HeaderUserAgent,
+		HeaderVary,
+		HeaderVia,
+		HeaderWarning,
+		HeaderWwwAuthenticate,
+
+		HeaderIdCount
+	};
+
+	HeaderId lookupHeader(const char* b, size_t n);
+	const char* headerName(HeaderId id);
+
+	inline HeaderId lookupHeader(const string& name) {
+		return lookupHeader(name.data(), name.size());
+	}
+
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Standard request methods, recognized by the request parser.  Extension methods are MethodOther and
+	//-- only available as the method string.
+
+	enum HttpMethod {
+		MethodOther,
+		MethodGet,
+		MethodHead,
+		MethodPost,
+		MethodPut,
+		MethodDelete,
+		MethodPatch,
+		MethodOptions,
+		MethodConnect,
+		MethodTrace,
+		MethodCount
+	};
+
+	HttpMethod lookupMethod(const char* b, size_t n);
+	const char* methodName(HttpMethod method);
+
+	inline HttpMethod lookupMethod(const string& method) {
+		return lookupMethod(method.data(), method.size());
+	}
+
+
 	//---------------------------------------------------------------------------------------------------------
 	//--
 
 	struct HttpHeader {
-		HttpHeader() {}
-		HttpHeader(const string& n, const string& v) : name(n), value(v) {}
+		HttpHeader() : id(HeaderOther) {}
+		HttpHeader(const string& n, const string& v) : name(n), value(v), id(lookupHeader(n)) {}
+		HttpHeader(HeaderId i, const string& v) : name(headerName(i)), value(v), id(i) {}
 
 		string name;
 		string value;
+		HeaderId id;
 	};
 
-	typedef list<HttpHeader> HttpHeaders;
+	typedef HeaderTable<HttpHeader> HttpHeaders;
 
 	string getHeaderValue(const HttpHeaders& headers, const string& tag);
+	string getHeaderValue(const HttpHeaders& headers, HeaderId id);
 
 
 	//---------------------------------------------------------------------------------------------------------
 	//--
 
 	struct RequestHeader {
-		RequestHeader() : versionmajor(1), versionminor(1) {}
+		typedef HttpHeaders Headers;
+
+		RequestHeader() : methodid(MethodOther), versionmajor(1), versionminor(1) {}
 
 		void clear() {
 			uri.clear();
 			method.clear();
+			methodid = MethodOther;
 			versionmajor = 0;
 			versionminor = 0;
 			headers.clear();
@@ -40,6 +268,7 @@ namespace httplib {
 		void swap(RequestHeader& o) {
 			uri.swap(o.uri);
 			method.swap(o.method);
+			std::swap(methodid, o.methodid);
 			std::swap(versionmajor, o.versionmajor);
 			std::swap(versionminor, o.versionminor);
 			headers.swap(o.headers);
@@ -47,6 +276,7 @@ namespace httplib {
 
 		string uri;
 		string method;
+		HttpMethod methodid;
 		int versionmajor;
 		int versionminor;
 		HttpHeaders headers;
@@ -57,6 +287,8 @@ namespace httplib {
 	//--
 
 	struct ResponseHeader {
+		typedef HttpHeaders Headers;
+
 		int code;
 		int versionmajor;
 		int versionminor;
@@ -80,6 +312,126 @@ namespace httplib {
 	};
 
 
+	//---------------------------------------------------------------------------------------------------------
+	//-- Zero-copy header types.  Tokens are (pointer, length) views into the buffer passed to feed(); a token
+	//-- that is split across feed() calls is copied into the arena owned by its header list.
+
+	struct StringRef {
+		typedef const char* const_iterator;
+
+		StringRef() : ptr(0), len(0) {}
+		StringRef(const char* p, size_t l) : ptr(p), len(l) {}
+		StringRef(const string& s) : ptr(s.data()), len(s.size()) {}
+
+		const char* data() const { return ptr; }
+		size_t size() const { return len; }
+		bool empty() const { return len == 0; }
+		const char* begin() const { return ptr; }
+		const char* end() const { return ptr + len; }
+		char operator[](size_t i) const { return ptr[i]; }
+
+		void clear() { ptr = 0; len = 0; }
+		string str() const { return string(ptr, len); }
+
+		const char* ptr;
+		size_t len;
+	};
+
+	bool operator==(const StringRef& l, const StringRef& r);
+	inline bool operator!=(const StringRef& l, const StringRef& r) { return !(l == r); }
+	inline bool operator==(const StringRef& l, const char* r) { return l == StringRef(r, strlen(r)); }
+
+	struct Arena {
+		Arena() : block(0), cur(0), last(0) {}
+		~Arena();
+
+		void clear();
+		void swap(Arena& o);
+
+		void append(StringRef& ref, const char* b, size_t n);
+		void pin(StringRef& ref, const char* b, const char* e);
+
+	private :
+
+		Arena(const Arena&);
+		Arena& operator=(const Arena&);
+
+		void reserve(size_t n);
+
+		vector<char*> blocks;
+		vector<size_t> sizes;
+		size_t block;
+		char* cur;
+		char* last;
+	};
+
+	struct HeaderView {
+		HeaderView() : id(HeaderOther) {}
+		HeaderView(const StringRef& n, const StringRef& v) : name(n), value(v), id(lookupHeader(n.data(), n.size())) {}
+
+		StringRef name;
+		StringRef value;
+		HeaderId id;
+	};
+
+	struct HeaderViews : public HeaderTable<HeaderView> {
+		void clear() {
+			HeaderTable<HeaderView>::clear();
+			arena.clear();
+		}
+
+		void swap(HeaderViews& o) {
+			HeaderTable<HeaderView>::swap(o);
+			arena.swap(o.arena);
+		}
+
+		Arena arena;
+	};
+
+	StringRef getHeaderValue(const HeaderViews& headers, const char* tag);
+	StringRef getHeaderValue(const HeaderViews& headers, HeaderId id);
+
+	struct RequestHeaderView {
+		typedef HeaderViews Headers;
+
+		RequestHeaderView() : methodid(MethodOther), versionmajor(1), versionminor(1) {}
+
+		void clear() {
+			uri.clear();
+			method.clear();
+			methodid = MethodOther;
+			versionmajor = 0;
+			versionminor = 0;
+			headers.clear();
+		}
+
+		StringRef uri;
+		StringRef method;
+		HttpMethod methodid;
+		int versionmajor;
+		int versionminor;
+		HeaderViews headers;
+	};
+
+	struct ResponseHeaderView {
+		typedef HeaderViews Headers;
+
+		int code;
+		int versionmajor;
+		int versionminor;
+		HeaderViews headers;
+
+		ResponseHeaderView() : code(500), versionmajor(0), versionminor(0) {}
+
+		void clear() {
+			code = 500;
+			versionmajor = 0;
+			versionminor = 0;
+			headers.clear();
+		}
+	};
+
+
 	//---------------------------------------------------------------------------------------------------------
 	//--
 
@@ -91,13 +443,25 @@ namespace httplib {
 	}
 
 	void toBuffers(const HttpHeader& o, Buffers& buffers);
-	void toBuffers(const list<HttpHeader>& o, Buffers& buffers);
+	void toBuffers(const HttpHeaders& o, Buffers& buffers);
 	void toBuffers(const ResponseHeader& o, Buffers& buffers);
 	void requestLineBuffers(const string &method, const string &resource, Buffers& buffers);
+
+	// Copies each run of segments shorter than threshold into scratch, so out has one iovec per run and one
+	// per larger segment.  scratch only grows; out points into it until the next call.
+	void coalesceBuffers(const iovec* vec, int c, size_t threshold, vector<char>& scratch, Buffers& out);
 	const char *responseCodePhrase(int code);
+
+	// The whole "HTTP/1.1 <code> <phrase>\r\n" line for the codes responseCodePhrase() knows, from static
+	// storage; an empty iovec for any other code.
+	iovec statusLineBuffer(int code);
+
 	iovec blanklineBuffer();
 	iovec chunkEndBuffer();
 
+	// "Date: <now>\r\n" from a per-thread cache; valid until the same thread asks again.
+	iovec dateLineBuffer();
+
 }
 
 #endif // httplib_src_header_h
@@ -18,6 +18,13 @@ namespace httplib {
 		HttpError(const string& msg) : runtime_error(msg) {}
 	};
 
+	// An error the peer caused, with the status code a server should answer it with.
+	struct HttpStatusError : public HttpError {
+		HttpStatusError(int c, const string& msg) : HttpError(msg), code(c) {}
+
+		int code;
+	};
+
 }
 
 #endif // httplib_src_httplib_h
@@ -0,0 +1,175 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "output.h"
+
+namespace httplib {
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	BufferPool::BufferPool(size_t s, size_t m) : size(s), maxFree(m) {
+	}
+
+	BufferPool::~BufferPool() {
+		for (vector<char*>::iterator i = free.begin(); i != free.end(); ++i)
+			delete[] *i;
+	}
+
+	char* BufferPool::get() {
+		if (free.empty())
+			return new char[size];
+		char* buffer = free.back();
+		free.pop_back();
+		return buffer;
+	}
+
+	void BufferPool::put(char* buffer) {
+		if (free.size() < maxFree)
+			free.push_back(buffer);
+		else
+			delete[] buffer;
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	// Block size without a pool.
+	static const size_t defaultBlockSize = 16 * 1024;
+
+	OutputQueue::OutputQueue(BufferPool* p) : pool(p), highWatermark(64 * 1024), lowWatermark(16 * 1024), bytes(0),
+		full(false) {
+	}
+
+	OutputQueue::~OutputQueue() {
+		clear();
+	}
+
+	void OutputQueue::append(const iovec* vec, int c, size_t skip) {
+		size_t size = blockSize();
+		for (int i = 0; i < c; ++i, skip = 0) {
+			const char* p = (const char*)vec[i].iov_base + skip;
+			size_t left = vec[i].iov_len - skip;
+			while (left != 0) {
+				if (blocks.empty() || blocks.back().file != -1 || blocks.back().end == size) {
+					Block block = { allocate(), 0, 0, -1, 0, 0 };
+					blocks.push_back(block);
+				}
+				Block& block = blocks.back();
+				size_t n = std::min(left, size - block.end);
+				memcpy(block.data + block.end, p, n);
+				block.end += n;
+				bytes += n;
+				p += n;
+				left -= n;
+			}
+		}
+		if (bytes >= highWatermark)
+			full = true;
+	}
+
+	void OutputQueue::appendFile(int fd, uint64_t offset, uint64_t length) {
+		if (length == 0)
+			return;
+		int file = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+		if (file == -1)
+			throw HttpError("Failed to queue file: " + string(strerror(errno)));
+		Block block = { 0, 0, 0, file, offset, length };
+		blocks.push_back(block);
+		bytes += length;
+		if (bytes >= highWatermark)
+			full = true;
+	}
+
+	int OutputQueue::front(iovec* vec, int c) {
+		int n = 0;
+		for (std::deque<Block>::iterator i = blocks.begin(); i != blocks.end() && n < c; ++i) {
+			if (i->file != -1)
+				break;
+			if (i->begin == i->end)
+				continue;
+			vec[n].iov_base = i->data + i->begin;
+			vec[n].iov_len = i->end - i->begin;
+			++n;
+		}
+		return n;
+	}
+
+	bool OutputQueue::frontFile(int& fd, uint64_t& offset, uint64_t& length) {
+		if (blocks.empty() || blocks.front().file == -1)
+			return false;
+		fd = blocks.front().file;
+		offset = blocks.front().offset;
+		length = blocks.front().left;
+		return true;
+	}
+
+	void OutputQueue::consume(size_t n) {
+		bytes -= n;
+		while (n != 0) {
+			Block& block = blocks.front();
+			bool done;
+			if (block.file != -1) {
+				size_t used = size_t(std::min(uint64_t(n), block.left));
+				block.offset += used;
+				block.left -= used;
+				n -= used;
+				done = block.left == 0;
+			}
+			else {
+				size_t used = std::min(n, block.end - block.begin);
+				block.begin += used;
+				n -= used;
+				done = block.begin == block.end;
+			}
+			if (done) {
+				release(block);
+				blocks.pop_front();
+			}
+		}
+		if (bytes <= lowWatermark)
+			full = false;
+	}
+
+	void OutputQueue::clear() {
+		for (std::deque<Block>::iterator i = blocks.begin(); i != blocks.end(); ++i)
+			release(*i);
+		blocks.clear();
+		bytes = 0;
+		full = false;
+	}
+
+	size_t OutputQueue::size() {
+		return bytes;
+	}
+
+	bool OutputQueue::empty() {
+		return bytes == 0;
+	}
+
+	bool OutputQueue::congested() {
+		return full;
+	}
+
+	size_t OutputQueue::blockSize() {
+		return pool != 0 ? pool->size : defaultBlockSize;
+	}
+
+	char* OutputQueue::allocate() {
+		return pool != 0 ? pool->get() : new char[defaultBlockSize];
+	}
+
+	void OutputQueue::release(Block& block) {
+		if (block.file != -1)
+			::close(block.file);
+		else if (pool != 0)
+			pool->put(block.data);
+		else
+			delete[] block.data;
+	}
+
+} // namespace httplib
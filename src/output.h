@@ -0,0 +1,91 @@
+#ifndef httplib_src_output_h
+#define httplib_src_output_h
+
+#include <sys/uio.h>
+#include <deque>
+
+#include "httplib.h"
+
+namespace httplib {
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Fixed size buffers shared by all connections of a reactor, for input the request couldn't take yet
+	//-- and for output the socket couldn't.
+
+	struct BufferPool {
+		explicit BufferPool(size_t size = 16 * 1024, size_t maxFree = 1024);
+		~BufferPool();
+
+		char* get();
+		void put(char* buffer);
+
+		size_t size;
+		size_t maxFree;
+
+	private :
+
+		BufferPool(const BufferPool&);
+		BufferPool& operator=(const BufferPool&);
+
+		vector<char*> free;
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Output waiting for a socket.  The iovecs handed to transmit() don't outlive the call, so the queue
+	//-- copies them into blocks it owns, taken from pool when there is one.  File ranges are queued by
+	//-- reference, on a descriptor of their own, and never read into memory.  A writer takes any number of
+	//-- bytes off the front; blocks already handed out by front() stay put until they're consumed, so an
+	//-- asynchronous write may go on while more is appended.
+	//--
+	//-- congested() turns true once highWatermark bytes are queued and false again at lowWatermark, so
+	//-- producers can pause instead of queueing without bound.
+
+	struct OutputQueue {
+		explicit OutputQueue(BufferPool* pool = 0);
+		~OutputQueue();
+
+		// Queues the iovecs, less skip bytes already written from the first one.
+		void append(const iovec* vec, int c, size_t skip = 0);
+		void appendFile(int fd, uint64_t offset, uint64_t length);
+
+		// Fills at most c iovecs with the front of the queue, up to the first file range; returns how many
+		// it filled.  When that's none, frontFile() tells where the file range at the front is.
+		int front(iovec* vec, int c);
+		bool frontFile(int& fd, uint64_t& offset, uint64_t& length);
+		void consume(size_t n);
+		void clear();
+
+		size_t size();
+		bool empty();
+		bool congested();
+
+		BufferPool* pool;
+		size_t highWatermark;
+		size_t lowWatermark;
+
+	private :
+
+		struct Block {
+			char* data;
+			size_t begin;
+			size_t end;
+			int file;			// -1 for data
+			uint64_t offset;
+			uint64_t left;
+		};
+
+		OutputQueue(const OutputQueue&);
+		OutputQueue& operator=(const OutputQueue&);
+
+		size_t blockSize();
+		char* allocate();
+		void release(Block& block);
+
+		std::deque<Block> blocks;
+		size_t bytes;
+		bool full;
+	};
+
+}
+
+#endif // httplib_src_output_h
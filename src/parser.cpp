@@ -1,43 +1,69 @@
 
+#include <time.h>
 #include <string.h>
 #include <sys/time.h>
 
 #include "parser.h"
+#include "scan.h"
 
 namespace httplib {
 
+	namespace chartype {
+
+		enum {
+			T = CharToken, C = CharCtl, W = CharWhite, D = CharDigit,
+			X = CharXDigit, A = CharAlpha, S = CharTSpecial, E = CharEscape
+		};
+
+		const unsigned char table[256] = {
+			C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|W|S|E, C|E, C|E, C|E, C|E, C|E, C|E,
+			C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E, C|E,
+			W|S|E, T, S, T, T, T, T, T, S, S, T, T, S, T, T, S,
+			T|D|X, T|D|X, T|D|X, T|D|X, T|D|X, T|D|X, T|D|X, T|D|X, T|D|X, T|D|X, S, S, S, S, S, S,
+			S, T|X|A, T|X|A, T|X|A, T|X|A, T|X|A, T|X|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A,
+			T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, S, S, S, T, T,
+			T, T|X|A, T|X|A, T|X|A, T|X|A, T|X|A, T|X|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A,
+			T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, T|A, S, T, S, T, C|E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+			E, E, E, E, E, E, E, E, E, E, E, E, E, E, E, E,
+		};
+
+	}
+
 	string unescapeString(const string& str) {
 		string r;
-		r.reserve(str.size());
-		for (string::const_iterator i = str.begin(); i != str.end(); ++i) {
-			if (*i == '%') {
-				if (++i == str.end() || !chartype::isXDigit(*i))
-					throw HttpError("invalid escape sequence in uri " + str);
-				int v = chartype::hexValue(*i) * 16;
-				if (++i == str.end() || !chartype::isXDigit(*i))
-					throw HttpError("invalid escape sequence in uri " + str);
-				r.push_back(char(v + chartype::hexValue(*i)));
-			}
-			else {
-				r.push_back(*i);
-			}
-		}
+		if (!unescapeString(str.data(), str.data() + str.size(), r))
+			throw HttpError("invalid escape sequence in uri " + str);
 		return r;
 	}
 
+	// Decodes into out, reusing its storage; out is left empty on a malformed escape.
+	bool unescapeString(const char* b, const char* e, string& out) {
+		out.resize(e - b);
+		if (b == e)
+			return true;
+		char* end = unescapeBytes(b, e, &out[0]);
+		out.resize(end != 0 ? end - &out[0] : 0);
+		return end != 0;
+	}
+
+	void appendEscaped(const char* b, const char* e, const char* extra, string& out) {
+		if (b == e)
+			return;
+		size_t n = out.size();
+		out.resize(n + (e - b) * 3);
+		out.resize(escapeBytes(b, e, extra, &out[n]) - &out[0]);
+	}
+
 	string escapeStringExtra(const string& src, const char* extra) {
 		string r;
-		r.reserve(src.size() * 9 / 8);
-		for (string::const_iterator i = src.begin(); i != src.end(); ++i) {
-			if (!chartype::isChar(*i) || chartype::isCtl(*i) || chartype::isWhite(*i) || strchr(extra, *i) != 0) {
-				r.push_back('%');
-				r.push_back(chartype::hexChar(static_cast<unsigned char>(*i) >> 4));
-				r.push_back(chartype::hexChar(static_cast<unsigned char>(*i) & 15));
-			}
-			else {
-				r.push_back(*i);
-			}
-		}
+		appendEscaped(src.data(), src.data() + src.size(), extra, r);
 		return r;
 	}
 
@@ -46,13 +72,18 @@ namespace httplib {
 	}
 
 	string hexSize(uint64_t size) {
-		string r;
+		char r[16];
+		return string(r, hexSize(size, r));
+	}
+
+	size_t hexSize(uint64_t size, char* out) {
+		size_t n = 0;
 		int i = 15;
 		while (i > 0 && (size & (uint64_t(0xff) << 56)) == 0)
 			i -= 2, size <<= 8;
 		while (i >= 0)
-			r.append(1, chartype::hexChar((size >> 60) & 0x0f)), --i, size <<= 4;
-		return r;
+			out[n++] = chartype::hexChar((size >> 60) & 0x0f), --i, size <<= 4;
+		return n;
 	}
 
 	string decSize(uint64_t size) {
@@ -64,6 +95,17 @@ namespace httplib {
 		return r;
 	}
 
+	size_t decSize(uint64_t size, char* out) {
+		char r[20];
+		size_t n = 0;
+		do
+			r[n++] = char(size % 10) + '0', size /= 10;
+		while (size != 0);
+		for (size_t i = 0; i < n; ++i)
+			out[i] = r[n - 1 - i];
+		return n;
+	}
+
 	double now() {
 		timeval tv;
 		gettimeofday(&tv, 0);
@@ -73,24 +115,49 @@ namespace httplib {
 	const char * days[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
 	const char * months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
 
-	string digits2(unsigned u) {
-		char c[3] = { (u / 10) + '0', (u % 10) + '0', 0 };
-		return c;
+	static char* digits2(char* out, unsigned u) {
+		*out++ = char(u / 10 + '0');
+		*out++ = char(u % 10 + '0');
+		return out;
 	}
 
-	string digits4(unsigned u) {
-		char c[5] = { (u / 1000) + '0', (u / 100) % 10 + '0', (u / 10) % 10 + '0', (u % 10) + '0', 0 };
-		return c;
+	static char* digits4(char* out, unsigned u) {
+		*out++ = char(u / 1000 + '0');
+		*out++ = char(u / 100 % 10 + '0');
+		return digits2(out, u % 100);
+	}
+
+	static char* copy3(char* out, const char* s) {
+		*out++ = s[0];
+		*out++ = s[1];
+		*out++ = s[2];
+		return out;
 	}
 
 	string dateStr(double time) {
+		char r[dateLength];
+		return string(r, dateStr(time_t(time), r));
+	}
+
+	size_t dateStr(time_t time, char* out) {
 		struct tm t;
-		time_t tt = int(time);
-		gmtime_r(&tt, &t);
-		string r = days[t.tm_wday];
-		r += ", " + digits2(t.tm_mday) + " " + months[t.tm_mon] + " " + digits4(t.tm_year + 1900);
-		r += " " + digits2(t.tm_hour) + ":" + digits2(t.tm_min) + ":" + digits2(t.tm_sec) + " GMT";
-		return r;
+		gmtime_r(&time, &t);
+		char* p = copy3(out, days[t.tm_wday]);
+		*p++ = ',';
+		*p++ = ' ';
+		p = digits2(p, t.tm_mday);
+		*p++ = ' ';
+		p = copy3(p, months[t.tm_mon]);
+		*p++ = ' ';
+		p = digits4(p, t.tm_year + 1900);
+		*p++ = ' ';
+		p = digits2(p, t.tm_hour);
+		*p++ = ':';
+		p = digits2(p, t.tm_min);
+		*p++ = ':';
+		p = digits2(p, t.tm_sec);
+		memcpy(p, " GMT", 4);
+		return p + 4 - out;
 	}
 
 }
@@ -1,8 +1,11 @@
 #ifndef httplib_src_parser_h
 #define httplib_src_parser_h
 
+#include <time.h>
+
 #include "httplib.h"
 #include "header.h"
+#include "scan.h"
 
 namespace httplib {
 
@@ -11,18 +14,39 @@ namespace httplib {
 
 	namespace chartype {
 
+		// Character class flags, one table lookup answers any of them.  Bytes above 127 only have
+		// CharEscape set.
+		enum CharFlags {
+			CharToken = 0x01,
+			CharCtl = 0x02,
+			CharWhite = 0x04,
+			CharDigit = 0x08,
+			CharXDigit = 0x10,
+			CharAlpha = 0x20,
+			CharTSpecial = 0x40,
+			CharEscape = 0x80
+		};
+
+		extern const unsigned char table[256];
+
+		inline bool is(int c, int flags) {
+			return (table[static_cast<unsigned char>(c)] & flags) != 0;
+		}
+
 		inline bool isChar(int c) {
 			return c >= 0 && c <= 127;
 		}
 
 		inline bool isCtl(int c) {
-			return (c >= 0 && c <= 31) || c == 127;
+			return is(c, CharCtl);
 		}
 
 		inline bool isTSpecial(int c) {
-			return c == '(' || c ==')' || c == '<' || c == '>' || c == '@' || c == ',' || c == ';' ||
-				c == ':' || c == '\\' || c == '"' || c == '/' || c == '[' || c == ']' || c == '?' ||
-				c == '=' || c == '{' || c == '}' || c == ' ' || c == '\t';
+			return is(c, CharTSpecial);
+		}
+
+		inline bool isToken(int c) {
+			return is(c, CharToken);
 		}
 
 		inline bool isUpper(int c) {
@@ -34,7 +58,7 @@ namespace httplib {
 		}
 
 		inline bool isAlpha(int c) {
-			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+			return is(c, CharAlpha);
 		}
 
 		inline char toLower(int c) {
@@ -42,11 +66,11 @@ namespace httplib {
 		}
 
 		inline bool isDigit(int c) {
-			return c >= '0' && c <= '9';
+			return is(c, CharDigit);
 		}
 
 		inline bool isXDigit(int c) {
-			return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+			return is(c, CharXDigit);
 		}
 
 		inline int hexValue(int c) {
@@ -62,7 +86,11 @@ namespace httplib {
 		}
 
 		inline bool isWhite(int c) {
-			return c == ' ' || c == '\t';
+			return is(c, CharWhite);
+		}
+
+		inline bool needsEscape(int c) {
+			return is(c, CharEscape);
 		}
 
 		static inline bool iCaseEqual(int l, int r)
@@ -73,14 +101,98 @@ namespace httplib {
 	}
 
 	//---------------------------------------------------------------------------------------------------------
-	//--
+	//-- Token storage.  Owned headers copy every byte.  Views point into the parsed buffer and anything still
+	//-- pointing into it when the buffer runs out mid-message is pinned into the arena.
+
+	inline void appendToken(HttpHeaders&, string& token, const char* b, const char* e) {
+		token.append(b, e);
+	}
+
+	inline void appendToken(HeaderViews& headers, StringRef& token, const char* b, const char* e) {
+		if (token.empty())
+			token = StringRef(b, e - b);
+		else
+			headers.arena.append(token, b, e - b);
+	}
+
+	inline void trimWhite(string& token) {
+		while (!token.empty() && chartype::isWhite(token[token.size() - 1]))
+			token.resize(token.size() - 1);
+	}
+
+	inline void trimWhite(StringRef& token) {
+		while (!token.empty() && chartype::isWhite(token[token.size() - 1]))
+			--token.len;
+	}
+
+	template <typename Arg> inline void pinTokens(Arg&, const char*, const char*) {}
+
+	inline void pinTokens(HeaderViews& headers, const char* b, const char* e) {
+		// Views that came from earlier buffers were pinned when those ran out, so stop at the first one.
+		for (HeaderViews::reverse_iterator i = headers.rbegin(); i != headers.rend(); ++i) {
+			bool inbuffer = (i->name.data() >= b && i->name.data() < e) || (i->value.data() >= b && i->value.data() < e);
+			if (!inbuffer)
+				break;
+			headers.arena.pin(i->name, b, e);
+			headers.arena.pin(i->value, b, e);
+		}
+	}
+
+	inline void pinTokens(RequestHeaderView& request, const char* b, const char* e) {
+		request.headers.arena.pin(request.method, b, e);
+		request.headers.arena.pin(request.uri, b, e);
+		pinTokens(request.headers, b, e);
+	}
+
+	inline void pinTokens(ResponseHeaderView& response, const char* b, const char* e) {
+		pinTokens(response.headers, b, e);
+	}
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Limits on what one message may make a parser store.  A message that exceeds one fails as soon as the
+	//-- limit is reached, with parseError() telling which kind of limit it was.
+
+	struct ParserLimits {
+		ParserLimits() : maxHeaderBytes(64 * 1024), maxHeaders(100), maxLineLength(8 * 1024), maxUriLength(8 * 1024) {}
+
+		size_t maxHeaderBytes;		// start line, headers and the blank line
+		size_t maxHeaders;			// header fields, including trailers parsed into the same headers
+		size_t maxLineLength;		// one header name and value, continuations included
+		size_t maxUriLength;		// request target
+	};
+
+	enum ParseError {
+		ParseOk,
+		ParseInvalid,
+		ParseUriTooLong,
+		ParseHeaderTooLarge,
+	};
 
 	template <typename Impl> struct ParserBase {
 		ParserBase() { clear(); }
 
 		template <typename Arg> const char* parse(const char* b, const char* e, Arg& arg) {
-			while (b != e && pstate != Impl::badState && pstate != Impl::endState)
-				b = static_cast<Impl&>(*this).parse_some(b, e, arg);
+			// Never look past the header byte limit, so an oversized header fails once the limit is
+			// reached instead of after the whole buffer has been copied.
+			const char* l = e;
+			if (size_t(e - b) > limits.maxHeaderBytes - consumed)
+				l = b + (limits.maxHeaderBytes - consumed);
+
+			const char* f = b;
+			if (pstate == Impl::startState) {
+				const char* r = static_cast<Impl&>(*this).parse_block(b, l, arg);
+				if (r != 0)
+					return consumed += r - f, r;
+			}
+
+			while (b != l && pstate != Impl::badState && pstate != Impl::endState)
+				b = static_cast<Impl&>(*this).parse_some(b, l, arg);
+			consumed += b - f;
+			if (pstate != Impl::badState && pstate != Impl::endState) {
+				if (consumed == limits.maxHeaderBytes)
+					return fail(ParseHeaderTooLarge, b);
+				pinTokens(arg, f, e);
+			}
 			return b;
 		}
 
@@ -92,8 +204,22 @@ namespace httplib {
 			return pstate == Impl::endState;
 		}
 
+		ParseError parseError() {
+			return isBad() ? error : ParseOk;
+		}
+
 		void clear() {
 			pstate = Impl::startState;
+			error = ParseInvalid;
+			consumed = 0;
+		}
+
+		ParserLimits limits;
+
+		// Parsers that can handle a whole message in one pass override this; returning 0 means the input
+		// should go through the resumable parse_some() states instead.
+		template <typename Arg> const char* parse_block(const char* b, const char* e, Arg& arg) {
+			return 0;
 		}
 
 	protected :
@@ -158,6 +284,12 @@ namespace httplib {
 			}
 		}
 
+		const char* fail(ParseError why, const char* b) {
+			pstate = Impl::badState;
+			error = why;
+			return b;
+		}
+
 		const char* parse_skip_past(const char* b, const char* e, int next, char match) {
 			for (;;) {
 				if (b == e)
@@ -168,13 +300,15 @@ namespace httplib {
 		}
 
 		int pstate;
+		ParseError error;
+		size_t consumed;
 	};
 
 	//------------------------------------------------------------------------------------------
 	//--
 
 	template <typename Impl> struct HeaderParser : public ParserBase<Impl> {
-		const char* parse_header_start(const char* b, const char* e, HttpHeaders& headers,
+		template <typename Headers> const char* parse_header_start(const char* b, const char* e, Headers& headers,
 			int next, int cont, int final) {
 			if (b == e)
 				return b;
@@ -182,23 +316,25 @@ namespace httplib {
 				return this->pstate = final, ++b;
 			if (chartype::isWhite(*b) && !headers.empty())
 				return this->pstate = cont, ++b;
-			if (!chartype::isChar(*b) || chartype::isCtl(*b) || chartype::isTSpecial(*b))
+			if (!chartype::isToken(*b))
 				return this->pstate = Impl::badState, b;
-			headers.push_back(HttpHeader());
+			if (headers.size() >= this->limits.maxHeaders)
+				return this->fail(ParseHeaderTooLarge, b);
+			headers.push_back(typename Headers::value_type());
 			return this->pstate = next, b;
 		}
 
-		const char* parse_header_name(const char* b, const char* e, HttpHeaders& headers, int next) {
-			for (;;) {
-				if (b == e)
-					return b;
-				if (*b == ':')
-					return this->pstate = next, ++b;
-				if (!chartype::isChar(*b) || chartype::isCtl(*b) || chartype::isTSpecial(*b))
-					return this->pstate = Impl::badState, b;
-				headers.back().name.push_back(*b);
-				++b;
-			}
+		template <typename Headers> const char* parse_header_name(const char* b, const char* e, Headers& headers, int next) {
+			const char* s = scanToken(b, e);
+			appendToken(headers, headers.back().name, b, s);
+			if (headers.back().name.size() > this->limits.maxLineLength)
+				return this->fail(ParseHeaderTooLarge, s);
+			if (s == e)
+				return s;
+			if (*s != ':')
+				return this->pstate = Impl::badState, s;
+			headers.back().id = lookupHeader(headers.back().name.data(), headers.back().name.size());
+			return this->pstate = next, ++s;
 		}
 
 		const char* parse_value_start(const char* b, const char* e, int next) {
@@ -211,32 +347,110 @@ namespace httplib {
 			}
 		}
 
-		const char* parse_header_value(const char* b, const char* e, HttpHeaders& headers, int next) {
-			string &value = headers.back().value;
+		template <typename Headers> const char* parse_header_value(const char* b, const char* e, Headers& headers, int next) {
+			const char* s = scanFieldValue(b, e);
+			appendToken(headers, headers.back().value, b, s);
+			if (headers.back().name.size() + headers.back().value.size() > this->limits.maxLineLength)
+				return this->fail(ParseHeaderTooLarge, s);
+			if (s == e)
+				return s;
+			if (*s == '\r') {
+				trimWhite(headers.back().value);
+				return this->pstate = next, ++s;
+			}
+			return this->pstate = Impl::badState, s;
+		}
+
+		//-- Straight-line parsing of a header block that is already known to be complete.  The block ends in
+		//-- "\r\n\r\n" and every scan below stops at a '\r', so none of them can run past its end.
+
+		const char* block_newline(const char* b) {
+			if (*b != '\n')
+				return this->pstate = Impl::badState, b;
+			return ++b;
+		}
+
+		template <typename Int> const char* block_integer(const char* b, Int& val, char end) {
+			if (!chartype::isDigit(*b))
+				return this->pstate = Impl::badState, b;
+			val = 0;
+			while (chartype::isDigit(*b))
+				val = val * 10 + (*b++ - '0');
+			if (*b != end)
+				return this->pstate = Impl::badState, b;
+			return ++b;
+		}
+
+		const char* block_version(const char* b, int& major, int& minor, char end) {
+			static const char tag[] = { 'H', 'T', 'T', 'P', '/' };
+			for (size_t i = 0; i < sizeof(tag); ++i, ++b)
+				if (*b != tag[i])
+					return this->pstate = Impl::badState, b;
+			b = block_integer(b, major, '.');
+			if (this->pstate == Impl::badState)
+				return b;
+			return block_integer(b, minor, end);
+		}
+
+		template <typename Headers> const char* block_headers(const char* b, const char* e, Headers& headers) {
+			static const char space[] = { ' ' };
 			for (;;) {
-				if (b == e)
-					return b;
 				if (*b == '\r') {
-					while (!value.empty() && chartype::isWhite(value[value.size() - 1]))
-						value.resize(value.size() - 1);
-					return this->pstate = next, ++b;
+					b = block_newline(b + 1);
+					if (this->pstate != Impl::badState)
+						this->pstate = Impl::endState;
+					return b;
 				}
-				if (chartype::isCtl(*b))
-					return this->pstate = Impl::badState, b;
-				value.push_back(*b);
-				++b;
+
+				if (chartype::isWhite(*b) && !headers.empty()) {
+					while (chartype::isWhite(*b))
+						++b;
+					if (*b == '\r') {
+						b = block_newline(b + 1);
+						if (this->pstate == Impl::badState)
+							return b;
+						continue;
+					}
+					appendToken(headers, headers.back().value, space, space + 1);
+				}
+				else {
+					if (!chartype::isToken(*b))
+						return this->pstate = Impl::badState, b;
+					if (headers.size() >= this->limits.maxHeaders)
+						return this->fail(ParseHeaderTooLarge, b);
+					headers.push_back(typename Headers::value_type());
+					const char* s = scanToken(b, e);
+					appendToken(headers, headers.back().name, b, s);
+					if (*s != ':')
+						return this->pstate = Impl::badState, s;
+					headers.back().id = lookupHeader(headers.back().name.data(), headers.back().name.size());
+					b = s + 1;
+					while (chartype::isWhite(*b))
+						++b;
+				}
+
+				const char* s = scanFieldValue(b, e);
+				appendToken(headers, headers.back().value, b, s);
+				if (headers.back().name.size() + headers.back().value.size() > this->limits.maxLineLength)
+					return this->fail(ParseHeaderTooLarge, s);
+				if (*s != '\r')
+					return this->pstate = Impl::badState, s;
+				trimWhite(headers.back().value);
+				b = block_newline(s + 1);
+				if (this->pstate == Impl::badState)
+					return b;
 			}
 		}
 
-		const char* parse_continuation(const char* b, const char* e, HttpHeaders& headers, int next, int blank) {
-			string &value = headers.back().value;
+		template <typename Headers> const char* parse_continuation(const char* b, const char* e, Headers& headers, int next, int blank) {
+			static const char space[] = { ' ' };
 			for (;;) {
 				if (b == e)
 					return b;
 				if (*b == '\r')
 					return this->pstate = blank, ++b;
 				if (!chartype::isWhite(*b)) {
-					value.push_back(' ');
+					appendToken(headers, headers.back().value, space, space + 1);
 					return this->pstate = next, b;
 				}
 				++b;
@@ -256,6 +470,8 @@ namespace httplib {
 			pstate_chunk_size,
 			pstate_extension,
 			pstate_eol,
+			pstate_data_cr,
+			pstate_data_lf,
 
 			pstate_done,
 		};
@@ -264,17 +480,33 @@ namespace httplib {
 		static const int endState = pstate_done;
 		static const int startState = pstate_chunk_start;
 
+		// Starts on the next chunk header, which follows the CRLF that ends the previous chunk's data.
+		void nextChunk() {
+			clear();
+			pstate = pstate_data_cr;
+		}
+
 		const char* parse_some(const char* b, const char* e, uint64_t& arg) {
 			switch (pstate) {
 			case pstate_chunk_start: return this->parse_xinteger_start(b, e, arg, pstate_chunk_size);
 			case pstate_chunk_size: return this->parse_xinteger(b, e, arg, pstate_extension);
 			case pstate_extension: return this->parse_skip_past(b, e, pstate_eol, '\r');
 			case pstate_eol: return parseNewLine(b, e, pstate_done);
+			case pstate_data_cr: return parse_data_end(b, e);
+			case pstate_data_lf: return parseNewLine(b, e, pstate_chunk_start);
 			case pstate_done: return b;
 			case pstate_bad: return b;
 			}
 			return this->pstate = pstate_bad, b;
 		}
+
+		const char* parse_data_end(const char* b, const char* e) {
+			if (b == e)
+				return b;
+			if (*b != '\r')
+				return this->pstate = pstate_bad, b;
+			return this->pstate = pstate_data_lf, ++b;
+		}
 	};
 
 	struct TailParser : public HeaderParser<TailParser> {
@@ -296,7 +528,7 @@ namespace httplib {
 		static const int endState = pstate_done;
 		static const int startState = pstate_header_start;
 
-		const char* parse_some(const char* b, const char* e, HttpHeaders& headers) {
+		template <typename Headers> const char* parse_some(const char* b, const char* e, Headers& headers) {
 			switch (pstate) {
 			case pstate_header_start: return parse_header_start(b, e, headers, pstate_header_name, pstate_continuation, pstate_final_eol);
 			case pstate_header_name: return parse_header_name(b, e, headers, pstate_value_start);
@@ -346,7 +578,7 @@ namespace httplib {
 		static const int endState = pstate_done;
 		static const int startState = pstate_method;
 
-		const char* parse_some(const char* b, const char* e, RequestHeader& request) {
+		template <typename Request> const char* parse_some(const char* b, const char* e, Request& request) {
 			switch (pstate) {
 			case pstate_method: return parse_method(b, e, request);
 			case pstate_uri: return parse_uri(b, e, request);
@@ -373,28 +605,59 @@ namespace httplib {
 			return this->pstate = pstate_bad, b;
 		}
 
-		const char* parse_method(const char* b, const char* e, RequestHeader& request) {
-			for (;;) {
-				if (b == e)
-					return b;
-				if (chartype::isSpace(*b))
-					return this->pstate = pstate_uri, ++b;
-				if (!chartype::isChar(*b) || chartype::isCtl(*b) || chartype::isTSpecial(*b))
-					return this->pstate = pstate_bad, b;
-				request.method.push_back(*b++);
-			}
-		}
-
-		const char* parse_uri(const char* b, const char* e, RequestHeader& request) {
-			for (;;) {
-				if (b == e)
-					return b;
-				if (chartype::isCtl(*b))
-					return this->pstate = pstate_bad, b;
-				if (chartype::isSpace(*b))
-					return this->pstate = pstate_http_h, ++b;
-				request.uri.push_back(*b++);
-			}
+		template <typename Request> const char* parse_block(const char* b, const char* e, Request& request) {
+			const char* end = scanHeaderEnd(b, e);
+			if (end == e)
+				return 0;
+			end += 4;
+
+			const char* s = scanToken(b, end);
+			appendToken(request.headers, request.method, b, s);
+			if (!chartype::isSpace(*s))
+				return this->pstate = pstate_bad, s;
+			request.methodid = lookupMethod(request.method.data(), request.method.size());
+
+			b = ++s;
+			while (!chartype::isCtl(*s) && !chartype::isSpace(*s))
+				++s;
+			appendToken(request.headers, request.uri, b, s);
+			if (request.uri.size() > limits.maxUriLength)
+				return fail(ParseUriTooLong, s);
+			if (!chartype::isSpace(*s))
+				return this->pstate = pstate_bad, s;
+
+			b = block_version(s + 1, request.versionmajor, request.versionminor, '\r');
+			if (pstate == pstate_bad)
+				return b;
+			b = block_newline(b);
+			if (pstate == pstate_bad)
+				return b;
+			return block_headers(b, end, request.headers);
+		}
+
+		template <typename Request> const char* parse_method(const char* b, const char* e, Request& request) {
+			const char* s = scanToken(b, e);
+			appendToken(request.headers, request.method, b, s);
+			if (s == e)
+				return s;
+			if (!chartype::isSpace(*s))
+				return this->pstate = pstate_bad, s;
+			request.methodid = lookupMethod(request.method.data(), request.method.size());
+			return this->pstate = pstate_uri, ++s;
+		}
+
+		template <typename Request> const char* parse_uri(const char* b, const char* e, Request& request) {
+			const char* s = b;
+			while (s != e && !chartype::isCtl(*s) && !chartype::isSpace(*s))
+				++s;
+			appendToken(request.headers, request.uri, b, s);
+			if (request.uri.size() > limits.maxUriLength)
+				return fail(ParseUriTooLong, s);
+			if (s == e)
+				return s;
+			if (chartype::isCtl(*s))
+				return this->pstate = pstate_bad, s;
+			return this->pstate = pstate_http_h, ++s;
 		}
 
 		const char* parse_http(const char* b, const char* e) {
@@ -451,7 +714,7 @@ namespace httplib {
 		static const int endState = pstate_done;
 		static const int startState = pstate_http_h;
 
-		const char* parse_some(const char* b, const char* e, ResponseHeader& response) {
+		template <typename Response> const char* parse_some(const char* b, const char* e, Response& response) {
 			switch (pstate) {
 			case pstate_http_h: return parse_http(b, e);
 			case pstate_http_t1: return parse_http(b, e);
@@ -482,6 +745,26 @@ namespace httplib {
 			return this->pstate = pstate_bad, b;
 		}
 
+		template <typename Response> const char* parse_block(const char* b, const char* e, Response& response) {
+			const char* end = scanHeaderEnd(b, e);
+			if (end == e)
+				return 0;
+			end += 4;
+
+			b = block_version(b, response.versionmajor, response.versionminor, ' ');
+			if (pstate == pstate_bad)
+				return b;
+			b = block_integer(b, response.code, ' ');
+			if (pstate == pstate_bad)
+				return b;
+			while (*b++ != '\r')
+				;
+			b = block_newline(b);
+			if (pstate == pstate_bad)
+				return b;
+			return block_headers(b, end, response.headers);
+		}
+
 		const char* parse_http(const char* b, const char* e) {
 			for (;;) {
 				if (b == e)
@@ -514,6 +797,12 @@ namespace httplib {
 		return iCaseEqual(r, l);
 	}
 
+	inline bool iCaseEqual(const StringRef &l, const char *r) {
+		for (size_t i = 0; i < l.size(); ++i)
+			if (r[i] == 0 || !chartype::iCaseEqual(l[i], r[i])) return false;
+		return r[l.size()] == 0;
+	}
+
 	template <typename I> I parseInteger(I b, I e, uint64_t & v) {
 		I ib(b);
 		while (b != e && chartype::isWhite(*b))
@@ -536,7 +825,7 @@ namespace httplib {
 
 	template <typename I> I skipPastComma(I b, I e) {
 		while (b != e && *b++ != ',')
-			++b;
+			;
 		return b;
 	}
 
@@ -564,12 +853,20 @@ namespace httplib {
 
 	double now();
 	string decSize(uint64_t size);
+	size_t decSize(uint64_t size, char* out);	// at most 20 digits, not terminated
 	string hexSize(uint64_t size);
+	size_t hexSize(uint64_t size, char* out);	// at most 16 digits, not terminated
 	string unescapeString(const string& str);
+	bool unescapeString(const char* b, const char* e, string& out);	// false on a malformed escape
 	string escapeString(const string& str);
 	string escapeStringExtra(const string& str, const char*);
+	void appendEscaped(const char* b, const char* e, const char* extra, string& out);
 	string dateStr(double time = now());
 
+	// IMF-fixdate, as in "Sun, 06 Nov 1994 08:49:37 GMT"; writes dateLength characters, not terminated.
+	static const size_t dateLength = 29;
+	size_t dateStr(time_t time, char* out);
+
 }
 
 #endif // httplib_src_parser_h
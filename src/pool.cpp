@@ -0,0 +1,142 @@
+
+#include "pool.h"
+#include "parser.h"
+#include "uri.h"
+
+namespace httplib {
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	// Scheme and authority, lower case and without the scheme's default port, so "http://h" and
+	// "HTTP://h:80" share connections.  Written into key, whose storage is reused.
+	static void poolKey(const UriView& uri, string& key) {
+		if (uri.scheme.empty())
+			key.assign("http");
+		else
+			key.assign(uri.scheme.begin(), uri.scheme.end());
+		key += "://";
+		key.append(uri.authority.begin(), uri.authority.end());
+		for (string::iterator i = key.begin(); i != key.end(); ++i)
+			*i = chartype::toLower(*i);
+
+		size_t port = key.rfind(':');
+		if (port != string::npos && port > key.find("://") && key.find(']', port) == string::npos) {
+			StringRef digits(key.data() + port + 1, key.size() - port - 1);
+			bool http = key.compare(0, 7, "http://") == 0;
+			bool https = key.compare(0, 8, "https://") == 0;
+			if (digits.empty() || (http && digits == "80") || (https && digits == "443"))
+				key.erase(port);
+		}
+	}
+
+	ClientPool::ClientPool() : maxIdle(32), maxPerHost(8), idleTimeout(30) {
+	}
+
+	ClientPool::~ClientPool() {
+		closeAll();
+	}
+
+	ClientRequest* ClientPool::acquire(const RequestHeader& header) {
+		return acquire(header.uri);
+	}
+
+	ClientRequest* ClientPool::acquire(const string& uri) {
+		expire();
+
+		UriView u(uri);
+		poolKey(u, key);
+
+		// The most recently used connection is the least likely to have been closed by the server.
+		for (list<IdleConnection>::iterator i = idle.end(); i != idle.begin();) {
+			if ((--i)->key == key) {
+				ClientRequest* request = i->request;
+				idle.erase(i);
+				return request;
+			}
+		}
+
+		std::map<string, size_t>::iterator count = open.find(key);
+		size_t n = count == open.end() ? 0 : count->second;
+		if (n >= maxPerHost)
+			return 0;
+
+		string authority;
+		if (!UriView::decode(u.authority, authority))
+			throw HttpError("Invalid authority in " + uri);
+		ClientRequest* request = create(u.scheme.str(), authority);
+		try {
+			owners[request] = key;
+			open[key] = n + 1;
+		}
+		catch (...) {
+			owners.erase(request);
+			destroy(request);
+			throw;
+		}
+		return request;
+	}
+
+	void ClientPool::release(ClientRequest* request) {
+		Owners::iterator owner = owners.find(request);
+		if (owner == owners.end())
+			throw HttpError("connection doesn't belong to this pool");
+
+		if (!request->isFinished() || request->shouldClose() || !request->isConnected() || maxIdle == 0) {
+			discard(owner);
+			return;
+		}
+
+		request->clear();
+		idle.push_back(IdleConnection(owner->second, request, now()));
+		if (idle.size() > maxIdle) {
+			ClientRequest* oldest = idle.front().request;
+			idle.pop_front();
+			discard(owners.find(oldest));
+		}
+	}
+
+	void ClientPool::expire(double time) {
+		while (!idle.empty() && time - idle.front().since > idleTimeout) {
+			ClientRequest* oldest = idle.front().request;
+			idle.pop_front();
+			discard(owners.find(oldest));
+		}
+	}
+
+	void ClientPool::closeIdle() {
+		while (!idle.empty()) {
+			ClientRequest* oldest = idle.front().request;
+			idle.pop_front();
+			discard(owners.find(oldest));
+		}
+	}
+
+	void ClientPool::closeAll() {
+		closeIdle();
+		while (!owners.empty())
+			discard(owners.begin());
+	}
+
+	size_t ClientPool::idleCount() {
+		return idle.size();
+	}
+
+	size_t ClientPool::openCount(const string& uri) {
+		poolKey(UriView(uri), key);
+		std::map<string, size_t>::iterator i = open.find(key);
+		return i == open.end() ? 0 : i->second;
+	}
+
+	void ClientPool::discard(Owners::iterator owner) {
+		ClientRequest* request = owner->first;
+		std::map<string, size_t>::iterator count = open.find(owner->second);
+		if (--count->second == 0)
+			open.erase(count);
+		owners.erase(owner);
+
+		request->dropConnection();
+		destroy(request);
+	}
+
+} // namespace httplib
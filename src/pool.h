@@ -0,0 +1,72 @@
+#ifndef httplib_src_pool_h
+#define httplib_src_pool_h
+
+#include <map>
+
+#include "httplib.h"
+#include "client.h"
+
+namespace httplib {
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Keeps idle keep-alive connections per scheme and authority.  A connection is a ClientRequest made by
+	//-- create().  acquire() hands out an idle one for the same host when there is one, release() takes it back
+	//-- once its response has ended and parks it until the next request or until it has been idle too long.
+
+	struct ClientPool {
+		ClientPool();
+		virtual ~ClientPool();
+
+		// Returns 0 when the host already has maxPerHost connections open.
+		ClientRequest* acquire(const RequestHeader& header);
+		ClientRequest* acquire(const string& uri);
+
+		// Connections that are finished and may stay open are cleared and kept, anything else is closed.
+		void release(ClientRequest* request);
+
+		void expire(double time = now());
+		void closeIdle();
+
+		// Closes idle connections and destroys the ones handed out too; the destructor does the same, so
+		// none of them may be used or released after the pool is gone.
+		void closeAll();
+
+		size_t idleCount();
+		size_t openCount(const string& uri);
+
+		virtual ClientRequest* create(const string& scheme, const string& authority) = 0;
+
+		// The base destructor can only use the default destroy(), so pools that override it should call
+		// closeAll() from their own destructor.
+		virtual void destroy(ClientRequest* request) { delete request; }
+
+		size_t maxIdle;
+		size_t maxPerHost;
+		double idleTimeout;
+
+	private :
+
+		ClientPool(const ClientPool&);
+		ClientPool& operator=(const ClientPool&);
+
+		struct IdleConnection {
+			IdleConnection(const string& k, ClientRequest* r, double t) : key(k), request(r), since(t) {}
+
+			string key;
+			ClientRequest* request;
+			double since;
+		};
+
+		typedef std::map<ClientRequest*, string> Owners;
+
+		void discard(Owners::iterator owner);
+
+		list<IdleConnection> idle;			// least recently used first
+		std::map<string, size_t> open;		// idle and in use, per host
+		Owners owners;
+		string key;							// scratch for acquire() and openCount()
+	};
+
+}
+
+#endif // httplib_src_pool_h
@@ -0,0 +1,790 @@
+
+#include <netdb.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+
+#include "reactor.h"
+#include "parser.h"
+#include "uring.h"
+
+namespace httplib {
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	// Segments shorter than this are copied together before they reach the socket or the output queue.
+	static const size_t coalesceLimit = 1024;
+
+	// Input a connection may have pending before the reactor stops receiving from it.  io_uring only; epoll
+	// stops reading at the first request that can't be answered yet.
+	static const size_t pendingLimit = 64 * 1024;
+
+	Connection::Connection(bool z) : ServerRequest(z), reactor(0), fd(-1), canRead(false), canWrite(true),
+		closing(false), closed(false), broken(false), busy(false), queued(false), peerClosed(false), uring(false),
+		receiving(false), throttled(false), sendBusy(false), scheduled(false), waiting(false), inflight(0), slot(0),
+		input(0), inputBegin(0), inputEnd(0), pendingBegin(0) {
+		setCoalescing(coalesceLimit);
+	}
+
+	Connection::~Connection() {
+	}
+
+	void Connection::transmit(const iovec* vec, int c) {
+		if (closed || broken)
+			return;
+
+		// The ring sends once per poll whatever was queued by then.
+		if (uring) {
+			output.append(vec, c);
+			reactor->schedule(this);
+			return;
+		}
+
+		// Write straight to the socket while nothing is queued, so most responses are never copied.
+		int i = 0;
+		size_t skip = 0;
+		if (output.empty() && canWrite) {
+			while (i < c) {
+				ssize_t n;
+				if (skip != 0) {
+					n = ::send(fd, (const char*)vec[i].iov_base + skip, vec[i].iov_len - skip, MSG_NOSIGNAL);
+				}
+				else {
+					msghdr msg;
+					memset(&msg, 0, sizeof(msg));
+					msg.msg_iov = (iovec*)vec + i;
+					msg.msg_iovlen = std::min(c - i, IOV_MAX);
+					n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+				}
+
+				if (n == -1 && errno == EINTR)
+					continue;
+				if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+					canWrite = false;
+					break;
+				}
+				if (n == -1) {
+					broken = true;
+					return;
+				}
+
+				size_t left = n;
+				while (i < c && left >= vec[i].iov_len - skip) {
+					left -= vec[i].iov_len - skip;
+					skip = 0;
+					++i;
+				}
+				skip += left;
+			}
+		}
+
+		if (i < c)
+			output.append(vec + i, c - i, skip);
+	}
+
+	void Connection::transmitFile(const iovec* vec, int c, int file, uint64_t offset, uint64_t length) {
+		if (closed || broken)
+			return;
+
+		// Queued by reference, so the file goes out with sendfile behind whatever is ahead of it.
+		output.append(vec, c);
+		output.appendFile(file, offset, length);
+		if (uring)
+			reactor->schedule(this);
+		else if (canWrite && !flush())
+			broken = true;
+	}
+
+	bool Connection::congested() {
+		if (output.congested())
+			waiting = true;
+		return waiting;
+	}
+
+	bool Connection::flush() {
+		while (!output.empty()) {
+			ssize_t n;
+			int file;
+			uint64_t offset, length;
+			if (output.frontFile(file, offset, length)) {
+				off_t position = offset;
+				n = ::sendfile(fd, file, &position, size_t(std::min(length, uint64_t(1) << 30)));
+				if (n == 0)
+					return false;	// the file is shorter than the response said
+			}
+			else {
+				// Hold back a partial segment while more is queued behind these buffers, a file most likely.
+				msghdr msg;
+				memset(&msg, 0, sizeof(msg));
+				msg.msg_iov = sending;
+				msg.msg_iovlen = output.front(sending, 16);
+				size_t size = 0;
+				for (size_t i = 0; i < msg.msg_iovlen; ++i)
+					size += sending[i].iov_len;
+				n = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (size < output.size() ? MSG_MORE : 0));
+			}
+			if (n != -1) {
+				output.consume(n);
+				continue;
+			}
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				canWrite = false;
+				return true;
+			}
+			return false;
+		}
+		return true;
+	}
+
+	bool Connection::accepting() {
+		return !broken && !closing && !(isFinished() && shouldClose()) && !output.congested();
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	// Epoll data for the stop() event; odd like the listener tags, but too large to be one.
+	static const uint64_t wakeTag = ~uint64_t(0);
+
+	// Ring completions carry a Connection pointer or a listening socket with the operation in the low bits.
+	enum RingTag {
+		tagReceive,
+		tagSend,
+		tagWritable,
+		tagCancel,
+		tagAccept,
+		tagWake,
+		tagMask = 7
+	};
+
+	static const unsigned ringEntries = 1024;
+	static const unsigned ringBuffers = 256;
+	static const double pauseSeconds = 0.1;
+
+	// Accept errors that last until some descriptor or memory is freed.
+	static bool exhausted(int err) {
+		return err == EMFILE || err == ENFILE || err == ENOBUFS || err == ENOMEM;
+	}
+
+	static uint64_t ringData(Connection* c, RingTag tag) {
+		return uint64_t(uintptr_t(c)) | tag;
+	}
+
+	Reactor::Reactor(ReactorBackend b) : readsPerEvent(16), epfd(-1), running(false), ring(0), wakeCount(0), pausedAt(0) {
+		// Blocking, since the ring would otherwise complete its read of it with EAGAIN.
+		wakefd = eventfd(0, EFD_CLOEXEC);
+		if (wakefd == -1)
+			throw HttpError("Failed to create wakeup event: " + string(strerror(errno)));
+
+		if (b == BackendUring) {
+			ring = new Ring();
+			if (ring->open(ringEntries, ringBuffers, buffers.size)) {
+				armWake();
+				return;
+			}
+			delete ring;
+			ring = 0;
+		}
+
+		epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (epfd == -1) {
+			::close(wakefd);
+			throw HttpError("Failed to create epoll instance: " + string(strerror(errno)));
+		}
+
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u64 = wakeTag;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev) == -1) {
+			::close(epfd);
+			::close(wakefd);
+			throw HttpError("Failed to create wakeup event: " + string(strerror(errno)));
+		}
+	}
+
+	Reactor::~Reactor() {
+		// Closing the ring cancels whatever is still in flight, so connections can go after it.
+		delete ring;
+		for (vector<Connection*>::iterator i = connections.begin(); i != connections.end(); ++i) {
+			::close((*i)->fd);
+			if ((*i)->input != 0)
+				buffers.put((*i)->input);
+			destroy(*i);
+		}
+		for (vector<Connection*>::iterator i = lingering.begin(); i != lingering.end(); ++i)
+			destroy(*i);
+		for (vector<Connection*>::iterator i = dead.begin(); i != dead.end(); ++i)
+			destroy(*i);
+		// Closed while waiting for another turn, so only the retry list still has them.
+		for (vector<Connection*>::iterator i = retry.begin(); i != retry.end(); ++i)
+			if ((*i)->closed && (*i)->inflight == 0)
+				destroy(*i);
+		::close(wakefd);
+		if (epfd != -1)
+			::close(epfd);
+	}
+
+	void Reactor::listen(int fd) {
+		if (ring != 0) {
+			listeners.push_back(fd);
+			armAccept(fd);
+			return;
+		}
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+		// Listening sockets are level-triggered; accept() stops watching one while descriptors run out.
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u64 = (uint64_t(fd) << 1) | 1;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+			throw HttpError("Failed to watch listening socket: " + string(strerror(errno)));
+		listeners.push_back(fd);
+	}
+
+	void Reactor::run() {
+		running = true;
+		while (running)
+			poll(-1);
+	}
+
+	void Reactor::stop() {
+		uint64_t one = 1;
+		if (::write(wakefd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+			throw HttpError("Failed to wake reactor: " + string(strerror(errno)));
+	}
+
+	size_t Reactor::connectionCount() {
+		return connections.size();
+	}
+
+	ReactorBackend Reactor::backend() {
+		return ring != 0 ? BackendUring : BackendEpoll;
+	}
+
+	void Reactor::poll(int timeout) {
+		if (!paused.empty()) {
+			double left = pausedAt + pauseSeconds - now();
+			if (left <= 0)
+				unpause();
+			else if (timeout < 0 || timeout > int(left * 1000) + 1)
+				timeout = int(left * 1000) + 1;
+		}
+
+		if (ring != 0) {
+			pollRing(timeout);
+			return;
+		}
+
+		epoll_event events[256];
+		int n = epoll_wait(epfd, events, 256, retry.empty() ? timeout : 0);
+		if (n == -1 && errno != EINTR)
+			throw HttpError("epoll_wait failed: " + string(strerror(errno)));
+
+		// Connections that still had input after their last turn go after this round's events.
+		ready.swap(retry);
+
+		for (int i = 0; i < n; ++i) {
+			if (events[i].data.u64 == wakeTag) {
+				uint64_t count;
+				if (::read(wakefd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+					throw HttpError("Failed to read wakeup event: " + string(strerror(errno)));
+				running = false;
+				continue;
+			}
+			if (events[i].data.u64 & 1) {
+				accept(int(events[i].data.u64 >> 1));
+				continue;
+			}
+
+			Connection* c = static_cast<Connection*>(events[i].data.ptr);
+			if (c->closed)
+				continue;
+			if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+				c->canRead = true;
+			if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+				c->canWrite = true;
+			process(c);
+		}
+
+		for (size_t i = 0; i < ready.size(); ++i) {
+			Connection* c = ready[i];
+			c->queued = false;
+			if (c->closed)
+				dead.push_back(c);
+			else
+				process(c);
+		}
+		ready.clear();
+
+		for (vector<Connection*>::iterator i = dead.begin(); i != dead.end(); ++i)
+			destroy(*i);
+		dead.clear();
+	}
+
+	void Reactor::resume(Connection* c) {
+		if (c->closed)
+			return;
+		if (ring == 0) {
+			process(c);
+			return;
+		}
+		if (!c->busy) {
+			consume(c, 0, 0);
+			finish(c);
+		}
+	}
+
+	void Reactor::accept(int fd) {
+		for (;;) {
+			int s = ::accept4(fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (s == -1 && (errno == EINTR || errno == ECONNABORTED))
+				continue;
+			if (s == -1) {
+				if (exhausted(errno))
+					pause(fd);
+				return;
+			}
+
+			int yes = 1;
+			setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+			Connection* c = create();
+			c->reactor = this;
+			c->fd = s;
+			c->output.pool = &buffers;
+
+			epoll_event ev;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+			ev.data.ptr = c;
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, s, &ev) == -1) {
+				::close(s);
+				destroy(c);
+				continue;
+			}
+
+			c->slot = connections.size();
+			connections.push_back(c);
+		}
+	}
+
+	// Out of descriptors the pending connection can't be taken, and the level-triggered listener would wake
+	// every poll at once.  It's set aside until a connection closes or pauseSeconds have passed, leaving
+	// the connection in the backlog meanwhile.
+	void Reactor::pause(int fd) {
+		if (paused.empty())
+			pausedAt = now();
+		paused.push_back(fd);
+		if (ring != 0)
+			return;
+		epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.data.u64 = (uint64_t(fd) << 1) | 1;
+		epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	}
+
+	void Reactor::unpause() {
+		for (vector<int>::iterator i = paused.begin(); i != paused.end(); ++i) {
+			if (ring != 0) {
+				armAccept(*i);
+				continue;
+			}
+			epoll_event ev;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.u64 = (uint64_t(*i) << 1) | 1;
+			epoll_ctl(epfd, EPOLL_CTL_MOD, *i, &ev);
+		}
+		paused.clear();
+	}
+
+	void Reactor::process(Connection* c) {
+		if (c->busy)
+			return;
+		c->busy = true;
+
+		try {
+			for (int reads = 0;;) {
+				// Earlier responses have to reach the socket before more requests are taken.
+				if (c->canWrite && !c->flush())
+					c->broken = true;
+				relieve(c);
+				if (c->broken || c->closing || !c->output.empty())
+					break;
+
+				// Input is only left over while a response is pending or the connection is closing.
+				if (c->inputBegin != c->inputEnd) {
+					c->inputBegin += c->feed(c->input + c->inputBegin, int(c->inputEnd - c->inputBegin));
+					if (c->inputBegin != c->inputEnd)
+						break;
+				}
+
+				if (!c->canRead || (c->isFinished() && c->shouldClose()))
+					break;
+
+				if (reads++ == readsPerEvent) {
+					if (!c->queued)
+						retry.push_back(c);
+					c->queued = true;
+					break;
+				}
+
+				if (c->input == 0)
+					c->input = buffers.get();
+				ssize_t n = ::read(c->fd, c->input, buffers.size);
+				if (n > 0) {
+					c->inputBegin = 0;
+					c->inputEnd = n;
+					continue;
+				}
+
+				if (n == -1 && errno == EINTR)
+					continue;
+				c->canRead = false;
+				if (n == 0)
+					c->peerClosed = true;
+				else if (errno != EAGAIN && errno != EWOULDBLOCK)
+					c->broken = true;
+				break;
+			}
+		}
+		catch (HttpStatusError& err) {
+			answer(c, err);
+		}
+		catch (std::exception& err) {
+			fail(c, err);
+			c->broken = true;
+		}
+
+		if (c->input != 0 && c->inputBegin == c->inputEnd) {
+			buffers.put(c->input);
+			c->input = 0;
+			c->inputBegin = c->inputEnd = 0;
+		}
+
+		c->busy = false;
+		finish(c);
+	}
+
+	void Reactor::answer(Connection* c, const HttpStatusError& err) {
+		fail(c, err);
+		if (!c->isResponding() && !c->isFinished()) {
+			static const char trailer[] = "Connection: close\r\nContent-Length: 0\r\n\r\n";
+			iovec v[2] = { statusLineBuffer(err.code), { (void*)trailer, sizeof(trailer) - 1 } };
+			string line;
+			if (v[0].iov_base == 0) {
+				line = "HTTP/1.1 " + decSize(err.code) + " " + responseCodePhrase(err.code) + "\r\n";
+				v[0].iov_base = &line[0];
+				v[0].iov_len = line.size();
+			}
+			c->transmit(v, 2);
+		}
+	}
+
+	// Tells a handler that paused on congested() to go on, once the output has drained.
+	void Reactor::relieve(Connection* c) {
+		if (c->waiting && !c->output.congested() && !c->broken && !c->closing) {
+			c->waiting = false;
+			c->writable();
+		}
+	}
+
+	void Reactor::fail(Connection* c, const std::exception& err) {
+		c->closing = true;
+		c->inputBegin = c->inputEnd;
+		c->pendingBegin = c->pending.size();
+		error(c, err);
+	}
+
+	void Reactor::finish(Connection* c) {
+		if (c->closed)
+			return;
+		bool idle = c->pendingBegin == c->pending.size() && !c->isResponding();
+		if (c->broken)
+			close(c);
+		else if (c->output.empty() && (c->closing || (c->isFinished() && c->shouldClose()) || (c->peerClosed && idle)))
+			close(c);
+	}
+
+	void Reactor::close(Connection* c) {
+		// Closing the descriptor also takes it out of the epoll set.  Ring operations hold on to the socket
+		// though, so shut it down first to end them.
+		if (c->uring)
+			::shutdown(c->fd, SHUT_RDWR);
+		::close(c->fd);
+		c->closed = true;
+		if (!paused.empty())
+			unpause();
+		if (c->input != 0)
+			buffers.put(c->input);
+		c->input = 0;
+		c->inputBegin = c->inputEnd = 0;
+		if (!c->sendBusy)
+			c->output.clear();
+
+		connections[c->slot] = connections.back();
+		connections[c->slot]->slot = c->slot;
+		connections.pop_back();
+
+		// Destroyed once the last ring operation referring to it has completed.
+		if (c->inflight != 0) {
+			c->slot = lingering.size();
+			lingering.push_back(c);
+		}
+		else if (!c->queued)
+			dead.push_back(c);
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//-- The io_uring backend.
+
+	void Reactor::pollRing(int timeout) {
+		// Output queued since the last poll goes out with this submission.
+		for (size_t i = 0; i < sends.size(); ++i)
+			send(sends[i]);
+		sends.clear();
+
+		ring->enter(timeout);
+
+		Ring::Event event;
+		for (int i = 0; i < 256 && ring->complete(event); ++i) {
+			int tag = int(event.data & tagMask);
+			if (tag == tagWake) {
+				running = false;
+				armWake();
+				continue;
+			}
+			if (tag == tagAccept) {
+				if (!event.more && exhausted(-event.result))
+					pause(int(event.data >> 3));
+				else if (!event.more)
+					armAccept(int(event.data >> 3));
+				if (event.result >= 0)
+					adopt(event.result);
+				continue;
+			}
+
+			Connection* c = reinterpret_cast<Connection*>(uintptr_t(event.data & ~uint64_t(tagMask)));
+			if (tag == tagReceive) {
+				if (!event.more) {
+					c->receiving = false;
+					--c->inflight;
+				}
+				if (event.buffer != -1) {
+					if (event.result > 0 && !c->closed)
+						consume(c, ring->buffer(event.buffer), event.result);
+					ring->recycle(event.buffer);
+				}
+				if (event.result == 0)
+					c->peerClosed = true;
+				else if (event.result < 0 && event.result != -ENOBUFS && event.result != -ECANCELED)
+					c->broken = true;
+				if (!c->closed && !c->receiving && !c->throttled && !c->peerClosed && !c->broken)
+					receive(c);
+			}
+			else if (tag == tagSend || tag == tagWritable) {
+				--c->inflight;
+				c->sendBusy = false;
+				if (event.result < 0)
+					c->broken = true;
+				else if (tag == tagSend)
+					c->output.consume(event.result);
+				if (!c->closed) {
+					schedule(c);
+					consume(c, 0, 0);
+				}
+			}
+			else
+				--c->inflight;
+
+			complete(c);
+		}
+
+		ring->publish();
+
+		for (size_t i = 0; i < sends.size(); ++i)
+			send(sends[i]);
+		sends.clear();
+
+		for (vector<Connection*>::iterator i = dead.begin(); i != dead.end(); ++i)
+			destroy(*i);
+		dead.clear();
+	}
+
+	void Reactor::armAccept(int fd) {
+		ring->accept(fd, (uint64_t(fd) << 3) | tagAccept);
+	}
+
+	void Reactor::armWake() {
+		ring->read(wakefd, &wakeCount, sizeof(wakeCount), tagWake);
+	}
+
+	void Reactor::adopt(int s) {
+		int yes = 1;
+		setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+		Connection* c = create();
+		c->reactor = this;
+		c->fd = s;
+		c->output.pool = &buffers;
+		c->uring = true;
+		c->slot = connections.size();
+		connections.push_back(c);
+		receive(c);
+	}
+
+	void Reactor::receive(Connection* c) {
+		ring->receive(c->fd, ringData(c, tagReceive));
+		c->receiving = true;
+		++c->inflight;
+	}
+
+	void Reactor::consume(Connection* c, const char* data, size_t n) {
+		if (c->busy)
+			return;
+		c->busy = true;
+
+		try {
+			relieve(c);
+
+			// Input held back earlier goes first; new input only follows once all of it has been taken.
+			if (c->pendingBegin != c->pending.size() && c->accepting())
+				c->pendingBegin += c->feed(&c->pending[c->pendingBegin], int(c->pending.size() - c->pendingBegin));
+			if (c->pendingBegin == c->pending.size()) {
+				c->pending.clear();
+				c->pendingBegin = 0;
+				if (n != 0 && c->accepting()) {
+					size_t used = c->feed(data, int(n));
+					data += used;
+					n -= used;
+				}
+			}
+			if (n != 0 && !c->closing && !c->broken)
+				c->pending.insert(c->pending.end(), data, data + n);
+		}
+		catch (HttpStatusError& err) {
+			answer(c, err);
+		}
+		catch (std::exception& err) {
+			fail(c, err);
+			c->broken = true;
+		}
+
+		c->busy = false;
+
+		// Stop receiving from a peer that sends faster than its requests are answered, until that's caught up.
+		size_t held = c->pending.size() - c->pendingBegin;
+		if (held > pendingLimit && c->receiving && !c->throttled) {
+			c->throttled = true;
+			ring->cancel(ringData(c, tagReceive), ringData(c, tagCancel));
+			++c->inflight;
+		}
+		else if (held == 0 && c->throttled) {
+			c->throttled = false;
+			if (!c->receiving && !c->peerClosed && !c->broken)
+				receive(c);
+		}
+	}
+
+	void Reactor::schedule(Connection* c) {
+		if (!c->scheduled)
+			sends.push_back(c);
+		c->scheduled = true;
+	}
+
+	void Reactor::send(Connection* c) {
+		c->scheduled = false;
+		if (c->closed || c->broken || c->sendBusy || c->output.empty())
+			return;
+
+		// The ring can't sendfile, but the socket is non-blocking: write from a file range on right here, and
+		// have the ring tell when there's room again.
+		int file;
+		uint64_t offset, length;
+		if (c->output.frontFile(file, offset, length)) {
+			c->canWrite = true;
+			if (!c->flush()) {
+				c->broken = true;
+				finish(c);
+			}
+			else if (!c->canWrite) {
+				ring->poll(c->fd, POLLOUT, ringData(c, tagWritable));
+				c->sendBusy = true;
+				++c->inflight;
+			}
+			return;
+		}
+
+		// The queue keeps the blocks handed out here in place until the send completes and consumes them.
+		memset(&c->message, 0, sizeof(c->message));
+		c->message.msg_iov = c->sending;
+		c->message.msg_iovlen = c->output.front(c->sending, 16);
+		ring->send(c->fd, &c->message, ringData(c, tagSend));
+		c->sendBusy = true;
+		++c->inflight;
+	}
+
+	void Reactor::complete(Connection* c) {
+		if (!c->closed) {
+			finish(c);
+			return;
+		}
+		if (c->inflight == 0) {
+			lingering[c->slot] = lingering.back();
+			lingering[c->slot]->slot = c->slot;
+			lingering.pop_back();
+			dead.push_back(c);
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	int listenSocket(const char* host, const char* service, int backlog, bool reusePort) {
+		addrinfo * addresses, proto;
+		memset(&proto, 0, sizeof(proto));
+		proto.ai_family = PF_UNSPEC;
+		proto.ai_socktype = SOCK_STREAM;
+		proto.ai_flags = AI_PASSIVE;
+		int err = getaddrinfo(host, service, &proto, &addresses);
+		if (err != 0)
+			throw HttpError("Failed to get local address: " + string(gai_strerror(err)));
+
+		int sock = -1;
+		for (addrinfo * a = addresses; a != 0; a = a->ai_next) {
+			sock = socket(a->ai_family, a->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, a->ai_protocol);
+			if (sock == -1)
+				continue;
+			int yes = 1;
+			setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+			if (reusePort)
+				setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+			if (::bind(sock, a->ai_addr, a->ai_addrlen) == 0 && ::listen(sock, backlog) == 0)
+				break;
+			::close(sock);
+			sock = -1;
+		}
+
+		freeaddrinfo(addresses);
+		if (sock == -1)
+			throw HttpError("Failed to bind socket: " + string(strerror(errno)));
+		return sock;
+	}
+
+} // namespace httplib
@@ -0,0 +1,160 @@
+#ifndef httplib_src_reactor_h
+#define httplib_src_reactor_h
+
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "httplib.h"
+#include "server.h"
+#include "output.h"
+
+namespace httplib {
+
+	struct Reactor;
+	struct Ring;
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- A server connection driven by a Reactor.  Handlers derive from it and answer requests as with any
+	//-- ServerRequest; transmit() writes what the socket takes right away and queues the rest.  On the
+	//-- io_uring backend it only queues, and the reactor sends everything queued in one go.  Files go out
+	//-- with sendfile(2) on either backend.  congested() follows the output queue, and writable() is called
+	//-- once it drains after congested() said so.  Responses are coalesced, see setCoalescing(), so a header
+	//-- takes one iovec rather than four per line.
+
+	struct Connection : public ServerRequest {
+		explicit Connection(bool zeroCopy = false);
+		virtual ~Connection();
+
+		virtual void transmit(const iovec* vec, int c);
+		virtual void transmitFile(const iovec* vec, int c, int fd, uint64_t offset, uint64_t length);
+		virtual bool congested();
+
+		Reactor* reactor;
+		int fd;
+		OutputQueue output;
+
+	private :
+
+		friend struct Reactor;
+
+		bool flush();
+		bool accepting();
+
+		bool canRead;
+		bool canWrite;
+		bool closing;		// answered an error, close once the output is written
+		bool closed;
+		bool broken;		// a write failed
+		bool busy;			// inside process(), so resume() from a callback doesn't feed recursively
+		bool queued;		// in the reactor's retry list
+		bool peerClosed;
+		bool uring;			// served by the reactor's ring rather than epoll
+		bool receiving;		// a multishot receive is armed
+		bool throttled;		// receive cancelled until the pending input drains
+		bool sendBusy;		// a send is in flight
+		bool scheduled;		// in the reactor's list of connections with output to send
+		bool waiting;		// congested() was true, so writable() is due once the output drains
+		unsigned inflight;	// ring operations that still refer to the connection
+		size_t slot;
+
+		char* input;
+		size_t inputBegin;
+		size_t inputEnd;
+
+		// io_uring only: received input a request couldn't take yet, and the send in flight.
+		vector<char> pending;
+		size_t pendingBegin;
+		msghdr message;
+		iovec sending[16];
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Edge-triggered epoll loop for one thread.  It accepts on its listening sockets, creates a Connection
+	//-- for each peer, feeds whatever arrives and closes connections once they're done.  A handler that
+	//-- answers outside its callbacks calls resume() afterwards so pipelined input is picked up again.
+	//-- stop() is the one call that may come from another thread.
+	//--
+	//-- With BackendUring the same loop runs on io_uring instead: a multishot accept per listener, multishot
+	//-- receives into a ring of provided buffers, and one submission for all sends of a poll.  Kernels
+	//-- without those features get epoll; backend() tells which one is in use.
+
+	enum ReactorBackend {
+		BackendEpoll,
+		BackendUring
+	};
+
+	struct Reactor {
+		explicit Reactor(ReactorBackend backend = BackendEpoll);
+		virtual ~Reactor();
+
+		void listen(int fd);
+		void run();
+		void poll(int timeout);
+		void stop();
+		void resume(Connection* connection);
+
+		size_t connectionCount();
+		ReactorBackend backend();
+
+		virtual Connection* create() = 0;
+
+		// As with ClientPool, the base destructor can only use the default destroy().
+		virtual void destroy(Connection* connection) { delete connection; }
+
+		// Called when a connection fails with an exception; peer errors have already been answered.
+		virtual void error(Connection* connection, const std::exception& err) {}
+
+		// Reads at most this many buffers from one connection before giving the others a turn.
+		int readsPerEvent;
+
+		BufferPool buffers;
+
+	private :
+
+		Reactor(const Reactor&);
+		Reactor& operator=(const Reactor&);
+
+		friend struct Connection;
+
+		void accept(int fd);
+		void adopt(int fd);
+		void pause(int fd);
+		void unpause();
+		void process(Connection* connection);
+		void answer(Connection* connection, const HttpStatusError& err);
+		void relieve(Connection* connection);
+		void fail(Connection* connection, const std::exception& err);
+		void finish(Connection* connection);
+		void close(Connection* connection);
+
+		void pollRing(int timeout);
+		void armAccept(int fd);
+		void armWake();
+		void receive(Connection* connection);
+		void consume(Connection* connection, const char* data, size_t size);
+		void schedule(Connection* connection);
+		void send(Connection* connection);
+		void complete(Connection* connection);
+
+		int epfd;
+		int wakefd;
+		bool running;
+		Ring* ring;
+		uint64_t wakeCount;
+		vector<Connection*> sends;
+		vector<Connection*> lingering;
+		vector<int> listeners;
+		vector<int> paused;		// listeners set aside while the descriptor table is full
+		double pausedAt;
+		vector<Connection*> connections;
+		vector<Connection*> ready;
+		vector<Connection*> retry;
+		vector<Connection*> dead;
+	};
+
+	// A non-blocking listening socket for host and service; a null host listens on all addresses.
+	int listenSocket(const char* host, const char* service, int backlog = 1024, bool reusePort = false);
+
+}
+
+#endif // httplib_src_reactor_h
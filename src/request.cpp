@@ -11,15 +11,15 @@ namespace httplib {
 	//--------------------------------------------------------------------------------------------------------------
 	//--
 
-	size_t bodyBuffers(bool chunked, list<string> &chunkLines, const iovec* vec, int c, Buffers& buffers) {
+	size_t bodyBuffers(bool chunked, char* chunkSize, const iovec* vec, int c, Buffers& buffers) {
 		size_t rsize = 0;
 		for (int i = 0; i < c; ++i)
 			rsize += vec[i].iov_len;
 
 		if (rsize != 0) {
 			if (chunked) {
-				chunkLines.push_back(hexSize(rsize));
-				buffers.push_back(toBuffer(chunkLines.back()));
+				iovec line = { chunkSize, hexSize(rsize, chunkSize) };
+				buffers.push_back(line);
 				buffers.push_back(blanklineBuffer());
 				buffers.insert(buffers.end(), vec, vec + c);
 				buffers.push_back(blanklineBuffer());
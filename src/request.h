@@ -14,7 +14,9 @@ namespace httplib {
 		BodyTransferChunked
 	};
 
-	size_t bodyBuffers(bool chunked, list<string> &chunkLines, const iovec* vec, int c, Buffers& buffers);
+	// Frames a body part for transmission.  In chunked mode the chunk size goes into chunkSize, which
+	// has room for 16 digits and is reused for the next part once this one has been transmitted.
+	size_t bodyBuffers(bool chunked, char* chunkSize, const iovec* vec, int c, Buffers& buffers);
 
 } // namespace httplib
 
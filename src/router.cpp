@@ -0,0 +1,241 @@
+#include <string.h>
+
+#include "router.h"
+
+namespace httplib {
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	bool RouteMatch::get(const StringRef& name, StringRef& value) const {
+		for (size_t i = 0; i < count; ++i) {
+			if (names[i] == name) {
+				value = values[i];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void RouteMatch::pin() {
+		size_t size = 0;
+		for (size_t i = 0; i < count; ++i)
+			size += values[i].size();
+		storage.resize(size);
+
+		size_t at = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (!values[i].empty())
+				memcpy(&storage[at], values[i].data(), values[i].size());
+			values[i] = StringRef(storage.data() + at, values[i].size());
+			at += values[i].size();
+		}
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	Router::Router() : nodes(1) {
+		for (size_t i = 0; i < MethodCount; ++i)
+			roots[i] = 0;
+	}
+
+	void Router::add(HttpMethod method, const string& pattern, RouteHandler* handler) {
+		add(string(methodName(method)), pattern, handler);
+	}
+
+	void Router::add(const string& method, const string& pattern, RouteHandler* handler) {
+		if (handler == 0)
+			throw HttpError("Route without a handler: " + pattern);
+
+		size_t n = root(lookupMethod(method), method);
+		size_t params = 0;
+		const char* b = pattern.data();
+		const char* e = b + pattern.size();
+		while (b != e) {
+			if (*b == ':' || *b == '*') {
+				const char* c = b + 1;
+				while (c != e && *c != '/')
+					++c;
+				if (c == b + 1)
+					throw HttpError("Unnamed parameter in route " + pattern);
+				if (memchr(b + 1, ':', c - b - 1) != 0 || memchr(b + 1, '*', c - b - 1) != 0)
+					throw HttpError("Invalid parameter name in route " + pattern);
+				if (++params > RouteMatch::maxParams)
+					throw HttpError("Too many parameters in route " + pattern);
+				if (*b == '*' && c != e)
+					throw HttpError("Wildcard not at the end of route " + pattern);
+				if (b != pattern.data() && b[-1] != '/')
+					throw HttpError("Parameter not at the start of a segment in route " + pattern);
+				n = insertParam(n, *b == ':' ? &Node::param : &Node::wildcard, string(b + 1, c));
+				b = c;
+			}
+			else {
+				const char* c = b;
+				while (c != e && *c != ':' && *c != '*')
+					++c;
+				n = insertStatic(n, b, c);
+				b = c;
+			}
+		}
+
+		if (nodes[n].handler != 0)
+			throw HttpError("Duplicate route " + method + " " + pattern);
+		nodes[n].handler = handler;
+	}
+
+	size_t Router::root(HttpMethod id, const string& method) {
+		size_t* slot = 0;
+		if (id != MethodOther)
+			slot = &roots[id];
+		else {
+			for (size_t i = 0; i < otherRoots.size() && slot == 0; ++i)
+				if (otherRoots[i].first == method)
+					slot = &otherRoots[i].second;
+			if (slot == 0) {
+				otherRoots.push_back(std::make_pair(method, size_t(0)));
+				slot = &otherRoots.back().second;
+			}
+		}
+		if (*slot == 0) {
+			*slot = nodes.size();
+			nodes.push_back(Node());
+		}
+		return *slot;
+	}
+
+	// Follows and splits static edges for [b, e); returns the node at its end.  Indexes rather than
+	// references, since adding a node moves the others.
+	size_t Router::insertStatic(size_t n, const char* b, const char* e) {
+		while (b != e) {
+			const char* f = static_cast<const char*>(memchr(nodes[n].first.data(), *b, nodes[n].first.size()));
+			if (f == 0) {
+				size_t child = nodes.size();
+				nodes.push_back(Node());
+				nodes[child].prefix.assign(b, e);
+				nodes[n].first.push_back(*b);
+				nodes[n].children.push_back(child);
+				return child;
+			}
+
+			size_t i = f - nodes[n].first.data();
+			size_t child = nodes[n].children[i];
+			const string& prefix = nodes[child].prefix;
+			size_t l = 0;
+			while (l < prefix.size() && b + l != e && prefix[l] == b[l])
+				++l;
+
+			if (l < prefix.size()) {
+				size_t mid = nodes.size();
+				nodes.push_back(Node());
+				nodes[mid].prefix.assign(nodes[child].prefix, 0, l);
+				nodes[child].prefix.erase(0, l);
+				nodes[mid].first.push_back(nodes[child].prefix[0]);
+				nodes[mid].children.push_back(child);
+				nodes[n].children[i] = mid;
+				child = mid;
+			}
+
+			n = child;
+			b += l;
+		}
+		return n;
+	}
+
+	size_t Router::insertParam(size_t n, size_t Node::* slot, const string& name) {
+		size_t child = nodes[n].*slot;
+		if (child != 0) {
+			if (nodes[child].prefix != name)
+				throw HttpError("Conflicting parameter names " + nodes[child].prefix + " and " + name);
+			return child;
+		}
+		child = nodes.size();
+		nodes.push_back(Node());
+		nodes[child].prefix = name;
+		nodes[n].*slot = child;
+		return child;
+	}
+
+	bool Router::match(HttpMethod id, const StringRef& method, const StringRef& path, RouteMatch& m) const {
+		m.clear();
+		size_t n = 0;
+		if (id != MethodOther)
+			n = roots[id];
+		else {
+			for (size_t i = 0; i < otherRoots.size() && n == 0; ++i)
+				if (method == otherRoots[i].first)
+					n = otherRoots[i].second;
+		}
+		if (n != 0 && match(n, path.begin(), path.end(), m))
+			return true;
+
+		// The server leaves out the body of a response to HEAD, so the GET handler can answer it.
+		if (id != MethodHead || roots[MethodGet] == 0)
+			return false;
+		m.clear();
+		return match(roots[MethodGet], path.begin(), path.end(), m);
+	}
+
+	bool Router::knows(const StringRef& path, string& allow) const {
+		RouteMatch m;
+		allow.clear();
+		for (size_t i = 1; i < MethodCount; ++i) {
+			bool found = roots[i] != 0 && match(roots[i], path.begin(), path.end(), m);
+			if (!found && i == MethodHead)
+				found = roots[MethodGet] != 0 && match(roots[MethodGet], path.begin(), path.end(), m);
+			if (found)
+				allow.append(allow.empty() ? "" : ", ").append(methodName(HttpMethod(i)));
+			m.clear();
+		}
+		for (size_t i = 0; i < otherRoots.size(); ++i) {
+			if (match(otherRoots[i].second, path.begin(), path.end(), m))
+				allow.append(allow.empty() ? "" : ", ").append(otherRoots[i].first);
+			m.clear();
+		}
+		return !allow.empty();
+	}
+
+	// The edge into n has been matched; matches [b, e) below it.
+	bool Router::match(size_t n, const char* b, const char* e, RouteMatch& m) const {
+		const Node& node = nodes[n];
+		if (b == e && node.handler != 0) {
+			m.handler = node.handler;
+			return true;
+		}
+
+		if (b != e) {
+			const char* f = static_cast<const char*>(memchr(node.first.data(), *b, node.first.size()));
+			if (f != 0) {
+				const Node& child = nodes[node.children[f - node.first.data()]];
+				size_t l = child.prefix.size();
+				if (size_t(e - b) >= l && memcmp(b, child.prefix.data(), l) == 0 &&
+					match(node.children[f - node.first.data()], b + l, e, m))
+					return true;
+			}
+		}
+
+		size_t count = m.count;
+		if (node.param != 0 && b != e && *b != '/') {
+			const char* c = static_cast<const char*>(memchr(b, '/', e - b));
+			if (c == 0)
+				c = e;
+			m.names[count] = nodes[node.param].prefix;
+			m.values[count] = StringRef(b, c - b);
+			m.count = count + 1;
+			if (match(node.param, c, e, m))
+				return true;
+			m.count = count;
+		}
+
+		if (node.wildcard != 0 && nodes[node.wildcard].handler != 0) {
+			m.names[count] = nodes[node.wildcard].prefix;
+			m.values[count] = StringRef(b, e - b);
+			m.count = count + 1;
+			m.handler = nodes[node.wildcard].handler;
+			return true;
+		}
+
+		return false;
+	}
+
+} // namespace httplib
@@ -0,0 +1,161 @@
+#ifndef httplib_src_router_h
+#define httplib_src_router_h
+
+#include "httplib.h"
+#include "header.h"
+#include "server.h"
+
+namespace httplib {
+
+	struct RouteMatch;
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- What a route leads to.  One handler object serves every request on its routes, from any number of
+	//-- connections, so per-request state belongs to the request.
+
+	struct RouteHandler {
+		virtual ~RouteHandler() {}
+
+		virtual void request(ServerRequest& request, RequestHeader& header, const RouteMatch& match) {}
+		virtual void request(ServerRequest& request, RequestHeaderView& header, const RouteMatch& match) {}
+		virtual void recv(ServerRequest& request, const char * b, int s) {}
+		virtual void end(ServerRequest& request, const RouteMatch& match) = 0;
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- The handler and path parameters a request was routed to.  Names point into the router and values
+	//-- into the request target, still escaped, until pin() copies them into the match.
+
+	struct RouteMatch {
+		static const size_t maxParams = 8;
+
+		RouteMatch() : handler(0), count(0) {}
+
+		void clear() {
+			handler = 0;
+			count = 0;
+		}
+
+		bool get(const StringRef& name, StringRef& value) const;
+
+		// Copies the values into storage of the match's own, for a match that outlives the target, once
+		// per match.  The storage is kept from one match to the next.
+		void pin();
+
+		RouteHandler* handler;
+		size_t count;
+		StringRef names[maxParams];
+		StringRef values[maxParams];
+
+	private :
+
+		string storage;
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Routes by method and path through one compressed radix tree per method.  Patterns are matched
+	//-- against the raw path, segment by segment:
+	//--
+	//--   /users/:id/orders     ":id" matches one non-empty segment
+	//--   /static/*path         "*path" matches the rest of the path, possibly empty; only last
+	//--
+	//-- Static edges are tried before a parameter and a parameter before a wildcard, falling back when the
+	//-- more specific one leads nowhere.  A lookup follows the path down the tree, so it doesn't depend on
+	//-- the number of routes, and allocates nothing.  Routes are added before serving; add() throws on a
+	//-- pattern that is already there or that conflicts with another.
+
+	struct Router {
+		Router();
+
+		void add(HttpMethod method, const string& pattern, RouteHandler* handler);
+		void add(const string& method, const string& pattern, RouteHandler* handler);
+
+		// method is only compared for MethodOther.  HEAD falls back to the GET route.
+		bool match(HttpMethod id, const StringRef& method, const StringRef& path, RouteMatch& match) const;
+
+		// True when the path has a route for any method, so that a miss is a 405 rather than a 404; allow
+		// is set to those methods, as the Allow header lists them.
+		bool knows(const StringRef& path, string& allow) const;
+
+	private :
+
+		struct Node {
+			Node() : param(0), wildcard(0), handler(0) {}
+
+			string prefix;				// static text on the edge into the node; the name of a parameter
+			string first;				// first byte of each static child's prefix
+			vector<size_t> children;	// static children, in the order of first
+			size_t param;				// child matching a segment, or 0
+			size_t wildcard;			// child matching the rest, or 0
+			RouteHandler* handler;
+		};
+
+		size_t root(HttpMethod id, const string& method);
+		size_t insertStatic(size_t n, const char* b, const char* e);
+		size_t insertParam(size_t n, size_t Node::* slot, const string& name);
+		bool match(size_t n, const char* b, const char* e, RouteMatch& match) const;
+
+		// Node 0 is a placeholder, so 0 can mean no node.
+		vector<Node> nodes;
+		size_t roots[MethodCount];
+		vector<std::pair<string, size_t> > otherRoots;
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Hands the requests of a ServerRequest (or Connection) to the handlers a router picks.  Requests that
+	//-- have no route are answered with 404, or 405 and an Allow header when the path has a route for
+	//-- another method.  In zero copy mode the target is only valid during request(), so the match is
+	//-- pinned before the handler sees it; either way it stays valid until end() has returned.
+
+	template <typename Base> struct Routed : public Base {
+		explicit Routed(const Router* r = 0, bool zeroCopy = false) : Base(zeroCopy), router(r), missed(0) {}
+
+		virtual void request(RequestHeader& header) {
+			if (route(header.methodid, header.method))
+				match.handler->request(*this, header, match);
+		}
+
+		virtual void request(RequestHeaderView& header) {
+			if (route(header.methodid, header.method)) {
+				match.pin();
+				match.handler->request(*this, header, match);
+			}
+		}
+
+		virtual void recv(const char * b, int s) {
+			if (match.handler != 0)
+				match.handler->recv(*this, b, s);
+		}
+
+		virtual void end() {
+			if (match.handler != 0)
+				match.handler->end(*this, match);
+			else {
+				ResponseHeader header;
+				header.code = missed;
+				if (missed == 405)
+					header.headers.push_back(HttpHeader("Allow", allowed));
+				this->response(header, "", 0);
+			}
+		}
+
+		const Router* router;
+		RouteMatch match;
+
+	private :
+
+		bool route(HttpMethod id, const StringRef& method) {
+			const StringRef& path = this->target().path;
+			if (router != 0 && router->match(id, method, path, match))
+				return true;
+			missed = router != 0 && router->knows(path, allowed) ? 405 : 404;
+			return false;
+		}
+
+		int missed;
+		string allowed;
+	};
+
+}
+
+#endif // httplib_src_router_h
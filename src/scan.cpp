@@ -0,0 +1,466 @@
+
+#include <string.h>
+
+#include "scan.h"
+#include "parser.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HTTPLIB_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace httplib {
+
+	typedef const char* (*ScanFunc)(const char* b, const char* e);
+	typedef char* (*EscapeFunc)(const char* b, const char* e, const char* extra, char* out);
+	typedef char* (*UnescapeFunc)(const char* b, const char* e, char* out);
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Portable versions, also used for the tail of the buffer by the vector versions.
+
+	static const char* scanTokenScalar(const char* b, const char* e) {
+		while (b != e && chartype::isToken(*b))
+			++b;
+		return b;
+	}
+
+	static const char* scanFieldValueScalar(const char* b, const char* e) {
+		while (b != e && !chartype::isCtl(*b))
+			++b;
+		return b;
+	}
+
+	static const char* scanHeaderEndScalar(const char* b, const char* e) {
+		while (e - b >= 4) {
+			const char* r = static_cast<const char*>(memchr(b, '\r', e - b - 3));
+			if (r == 0)
+				break;
+			if (r[1] == '\n' && r[2] == '\r' && r[3] == '\n')
+				return r;
+			b = r + 1;
+		}
+		return e;
+	}
+
+	static inline char* escapeByte(unsigned char c, bool escape, char* out) {
+		if (escape) {
+			*out++ = '%';
+			*out++ = chartype::hexChar(c >> 4);
+			*out++ = chartype::hexChar(c & 15);
+		}
+		else {
+			*out++ = c;
+		}
+		return out;
+	}
+
+	static char* escapeBytesScalar(const char* b, const char* e, const char* extra, char* out) {
+		uint32_t extraset[8] = { 0 };
+		for (const unsigned char* x = reinterpret_cast<const unsigned char*>(extra); *x != 0; ++x)
+			extraset[*x >> 5] |= 1u << (*x & 31);
+
+		for (; b != e; ++b) {
+			unsigned char c = *b;
+			out = escapeByte(c, chartype::needsEscape(c) || ((extraset[c >> 5] >> (c & 31)) & 1) != 0, out);
+		}
+		return out;
+	}
+
+	// Decodes the escape at b, which starts with '%'.
+	static inline const char* unescapeOne(const char* b, const char* e, char*& out) {
+		if (e - b < 3 || !chartype::isXDigit(b[1]) || !chartype::isXDigit(b[2]))
+			return 0;
+		*out++ = char(chartype::hexValue(b[1]) * 16 + chartype::hexValue(b[2]));
+		return b + 3;
+	}
+
+	// Decodes the escapes marked in bits of the width bytes at b, which are already copied to out up to the
+	// first of them.  Returns the input position past the last one, or 0 on a malformed escape.
+	static inline const char* unescapeMarked(const char* b, unsigned bits, unsigned width, const char* e,
+		char*& out) {
+		unsigned i = __builtin_ctz(bits);
+		out += i;
+		for (;;) {
+			if (unescapeOne(b + i, e, out) == 0)
+				return 0;
+			i += 3;
+			bits = i < width ? bits >> i << i : 0;
+			if (bits == 0)
+				return b + i;
+			for (unsigned next = __builtin_ctz(bits); i < next; ++i)
+				*out++ = b[i];
+		}
+	}
+
+	static char* unescapeBytesScalar(const char* b, const char* e, char* out) {
+		while (b != e) {
+			if (*b != '%')
+				*out++ = *b++;
+			else if ((b = unescapeOne(b, e, out)) == 0)
+				return 0;
+		}
+		return out;
+	}
+
+#ifdef HTTPLIB_SCAN_X86
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- SSE4.2: match 16 bytes at a time against byte ranges with pcmpestri.
+
+	__attribute__((target("sse4.2")))
+	static const char* scanTokenSse42(const char* b, const char* e) {
+		// Ranges of non-token bytes.  Only 8 ranges fit, so the last one also covers '|' and '~' which are
+		// rechecked below.
+		static const char ranges[16] = {
+			'\x00', ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':', '@', '[', ']', '{', '\xff'
+		};
+		const __m128i r = _mm_loadu_si128((const __m128i*)ranges);
+		while (e - b >= 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)b);
+			int i = _mm_cmpestri(r, 16, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+			if (i == 16) {
+				b += 16;
+				continue;
+			}
+			b += i;
+			if (!chartype::isToken(*b))
+				return b;
+			++b;
+		}
+		return scanTokenScalar(b, e);
+	}
+
+	__attribute__((target("sse4.2")))
+	static const char* scanFieldValueSse42(const char* b, const char* e) {
+		static const char ranges[16] = { '\x00', '\x1f', '\x7f', '\x7f' };
+		const __m128i r = _mm_loadu_si128((const __m128i*)ranges);
+		while (e - b >= 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)b);
+			int i = _mm_cmpestri(r, 4, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+			if (i != 16)
+				return b + i;
+			b += 16;
+		}
+		return scanFieldValueScalar(b, e);
+	}
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- AVX2: 32 bytes at a time.  Token bytes are classified with a nibble lookup; bit (c >> 4) of
+	//-- tokenLow[c & 15] is set when c is a token byte.
+
+	__attribute__((target("avx2")))
+	static const char* scanTokenAvx2(const char* b, const char* e) {
+		static const char tokenLow[16] = {
+			'\xe8', '\xfc', '\xf8', '\xfc', '\xfc', '\xfc', '\xfc', '\xfc',
+			'\xf8', '\xf8', '\xf4', '\x54', '\xd0', '\x54', '\xf4', '\x70'
+		};
+		static const char highBit[16] = {
+			'\x01', '\x02', '\x04', '\x08', '\x10', '\x20', '\x40', '\x80', 0, 0, 0, 0, 0, 0, 0, 0
+		};
+		const __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)tokenLow));
+		const __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)highBit));
+		const __m256i nibble = _mm256_set1_epi8(0x0f);
+		const __m256i zero = _mm256_setzero_si256();
+		while (e - b >= 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)b);
+			__m256i l = _mm256_shuffle_epi8(low, _mm256_and_si256(v, nibble));
+			__m256i h = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+			unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(l, h), zero));
+			if (m != 0)
+				return b + __builtin_ctz(m);
+			b += 32;
+		}
+		return scanTokenSse42(b, e);
+	}
+
+	__attribute__((target("avx2")))
+	static const char* scanFieldValueAvx2(const char* b, const char* e) {
+		const __m256i ctl = _mm256_set1_epi8(0x1f);
+		const __m256i del = _mm256_set1_epi8(0x7f);
+		while (e - b >= 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)b);
+			__m256i c = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v), _mm256_cmpeq_epi8(v, del));
+			unsigned m = _mm256_movemask_epi8(c);
+			if (m != 0)
+				return b + __builtin_ctz(m);
+			b += 32;
+		}
+		return scanFieldValueSse42(b, e);
+	}
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- End of header block: compare four shifted loads against "\r\n\r\n" so each bit of the mask marks
+	//-- a complete match.
+
+	__attribute__((target("sse2")))
+	static const char* scanHeaderEndSse2(const char* b, const char* e) {
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		while (e - b >= 19) {
+			__m128i m = _mm_and_si128(
+				_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)b), cr),
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(b + 1)), lf)),
+				_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(b + 2)), cr),
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(b + 3)), lf)));
+			unsigned bits = _mm_movemask_epi8(m);
+			if (bits != 0)
+				return b + __builtin_ctz(bits);
+			b += 16;
+		}
+		return scanHeaderEndScalar(b, e);
+	}
+
+	__attribute__((target("avx2")))
+	static const char* scanHeaderEndAvx2(const char* b, const char* e) {
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		while (e - b >= 35) {
+			__m256i m = _mm256_and_si256(
+				_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)b), cr),
+					_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(b + 1)), lf)),
+				_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(b + 2)), cr),
+					_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(b + 3)), lf)));
+			unsigned bits = _mm256_movemask_epi8(m);
+			if (bits != 0)
+				return b + __builtin_ctz(bits);
+			b += 32;
+		}
+		return scanHeaderEndSse2(b, e);
+	}
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Percent-encoding.  Each vector is stored whole before its mask is looked at, and from the first byte
+	//-- that needs work the rest of it is finished byte by byte; the room the caller provides always covers
+	//-- those stores.  Bytes that need escaping are the controls, space, DEL and everything above it: as
+	//-- signed bytes, those not greater than ' ' or equal to DEL.  Up to maxExtra extra bytes are compared
+	//-- one by one, more go to the scalar version.
+
+	static const size_t maxExtra = 8;
+
+	__attribute__((target("sse2")))
+	static char* escapeBytesSse2(const char* b, const char* e, const char* extra, char* out) {
+		size_t n = strlen(extra);
+		if (n > maxExtra)
+			return escapeBytesScalar(b, e, extra, out);
+		__m128i extras[maxExtra];
+		for (size_t i = 0; i < n; ++i)
+			extras[i] = _mm_set1_epi8(extra[i]);
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i del = _mm_set1_epi8(0x7f);
+		while (e - b >= 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)b);
+			__m128i m = _mm_or_si128(_mm_cmpgt_epi8(space, v), _mm_cmpeq_epi8(v, space));
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, del));
+			for (size_t i = 0; i < n; ++i)
+				m = _mm_or_si128(m, _mm_cmpeq_epi8(v, extras[i]));
+			unsigned bits = _mm_movemask_epi8(m);
+			_mm_storeu_si128((__m128i*)out, v);
+			if (bits == 0) {
+				b += 16;
+				out += 16;
+				continue;
+			}
+			unsigned i = __builtin_ctz(bits);
+			out += i;
+			for (; i < 16; ++i)
+				out = escapeByte(b[i], ((bits >> i) & 1) != 0, out);
+			b += 16;
+		}
+		return escapeBytesScalar(b, e, extra, out);
+	}
+
+	__attribute__((target("avx2")))
+	static char* escapeBytesAvx2(const char* b, const char* e, const char* extra, char* out) {
+		size_t n = strlen(extra);
+		if (n > maxExtra)
+			return escapeBytesScalar(b, e, extra, out);
+		__m256i extras[maxExtra];
+		for (size_t i = 0; i < n; ++i)
+			extras[i] = _mm256_set1_epi8(extra[i]);
+		const __m256i space = _mm256_set1_epi8(' ');
+		const __m256i del = _mm256_set1_epi8(0x7f);
+		while (e - b >= 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)b);
+			__m256i m = _mm256_or_si256(_mm256_cmpgt_epi8(space, v), _mm256_cmpeq_epi8(v, space));
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, del));
+			for (size_t i = 0; i < n; ++i)
+				m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, extras[i]));
+			unsigned bits = _mm256_movemask_epi8(m);
+			_mm256_storeu_si256((__m256i*)out, v);
+			if (bits == 0) {
+				b += 32;
+				out += 32;
+				continue;
+			}
+			unsigned i = __builtin_ctz(bits);
+			out += i;
+			for (; i < 32; ++i)
+				out = escapeByte(b[i], ((bits >> i) & 1) != 0, out);
+			b += 32;
+		}
+		return escapeBytesSse2(b, e, extra, out);
+	}
+
+	__attribute__((target("sse2")))
+	static char* unescapeBytesSse2(const char* b, const char* e, char* out) {
+		const __m128i percent = _mm_set1_epi8('%');
+		while (e - b >= 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)b);
+			unsigned bits = _mm_movemask_epi8(_mm_cmpeq_epi8(v, percent));
+			_mm_storeu_si128((__m128i*)out, v);
+			if (bits == 0) {
+				b += 16;
+				out += 16;
+				continue;
+			}
+			if ((b = unescapeMarked(b, bits, 16, e, out)) == 0)
+				return 0;
+		}
+		return unescapeBytesScalar(b, e, out);
+	}
+
+	__attribute__((target("avx2")))
+	static char* unescapeBytesAvx2(const char* b, const char* e, char* out) {
+		const __m256i percent = _mm256_set1_epi8('%');
+		while (e - b >= 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)b);
+			unsigned bits = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, percent));
+			_mm256_storeu_si256((__m256i*)out, v);
+			if (bits == 0) {
+				b += 32;
+				out += 32;
+				continue;
+			}
+			if ((b = unescapeMarked(b, bits, 32, e, out)) == 0)
+				return 0;
+		}
+		return unescapeBytesSse2(b, e, out);
+	}
+
+	static ScanFunc selectScan(ScanFunc avx2, ScanFunc sse42, ScanFunc scalar) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return avx2;
+		if (__builtin_cpu_supports("sse4.2"))
+			return sse42;
+		return scalar;
+	}
+
+	template <typename Func> static Func selectCoder(Func avx2, Func sse2, Func scalar) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return avx2;
+		if (__builtin_cpu_supports("sse2"))
+			return sse2;
+		return scalar;
+	}
+
+	// The pointers start out at resolvers, so they are set before any code runs and a scan or escape
+	// made during another file's static initialization still works.  The first call picks the kernel
+	// and stores it; threads racing there store the same pointer.
+	static const char* resolveToken(const char* b, const char* e);
+	static const char* resolveFieldValue(const char* b, const char* e);
+	static const char* resolveHeaderEnd(const char* b, const char* e);
+
+	static ScanFunc tokenScanner = resolveToken;
+	static ScanFunc fieldValueScanner = resolveFieldValue;
+	static ScanFunc headerEndScanner = resolveHeaderEnd;
+
+	static const char* resolveToken(const char* b, const char* e) {
+		ScanFunc f = selectScan(scanTokenAvx2, scanTokenSse42, scanTokenScalar);
+		__atomic_store_n(&tokenScanner, f, __ATOMIC_RELAXED);
+		return f(b, e);
+	}
+
+	static const char* resolveFieldValue(const char* b, const char* e) {
+		ScanFunc f = selectScan(scanFieldValueAvx2, scanFieldValueSse42, scanFieldValueScalar);
+		__atomic_store_n(&fieldValueScanner, f, __ATOMIC_RELAXED);
+		return f(b, e);
+	}
+
+	static const char* resolveHeaderEnd(const char* b, const char* e) {
+		ScanFunc f = selectScan(scanHeaderEndAvx2, scanHeaderEndSse2, scanHeaderEndScalar);
+		__atomic_store_n(&headerEndScanner, f, __ATOMIC_RELAXED);
+		return f(b, e);
+	}
+
+	static char* resolveEscape(const char* b, const char* e, const char* extra, char* out);
+	static char* resolveUnescape(const char* b, const char* e, char* out);
+
+	static EscapeFunc escaper = resolveEscape;
+	static UnescapeFunc unescaper = resolveUnescape;
+
+	static char* resolveEscape(const char* b, const char* e, const char* extra, char* out) {
+		EscapeFunc f = selectCoder(escapeBytesAvx2, escapeBytesSse2, escapeBytesScalar);
+		__atomic_store_n(&escaper, f, __ATOMIC_RELAXED);
+		return f(b, e, extra, out);
+	}
+
+	static char* resolveUnescape(const char* b, const char* e, char* out) {
+		UnescapeFunc f = selectCoder(unescapeBytesAvx2, unescapeBytesSse2, unescapeBytesScalar);
+		__atomic_store_n(&unescaper, f, __ATOMIC_RELAXED);
+		return f(b, e, out);
+	}
+
+	static const CoderKernel coders[] = {
+		{ "scalar", escapeBytesScalar, unescapeBytesScalar },
+		{ "sse2", escapeBytesSse2, unescapeBytesSse2 },
+		{ "avx2", escapeBytesAvx2, unescapeBytesAvx2 },
+	};
+
+	static size_t coderCount() {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return 3;
+		if (__builtin_cpu_supports("sse2"))
+			return 2;
+		return 1;
+	}
+
+#else
+
+	static const CoderKernel coders[] = {
+		{ "scalar", escapeBytesScalar, unescapeBytesScalar },
+	};
+
+	static size_t coderCount() {
+		return 1;
+	}
+
+	static ScanFunc tokenScanner = scanTokenScalar;
+	static ScanFunc fieldValueScanner = scanFieldValueScalar;
+	static ScanFunc headerEndScanner = scanHeaderEndScalar;
+	static EscapeFunc escaper = escapeBytesScalar;
+	static UnescapeFunc unescaper = unescapeBytesScalar;
+
+#endif
+
+	//---------------------------------------------------------------------------------------------------------
+	//--
+
+	const char* scanToken(const char* b, const char* e) {
+		return __atomic_load_n(&tokenScanner, __ATOMIC_RELAXED)(b, e);
+	}
+
+	const char* scanFieldValue(const char* b, const char* e) {
+		return __atomic_load_n(&fieldValueScanner, __ATOMIC_RELAXED)(b, e);
+	}
+
+	const char* scanHeaderEnd(const char* b, const char* e) {
+		return __atomic_load_n(&headerEndScanner, __ATOMIC_RELAXED)(b, e);
+	}
+
+	char* escapeBytes(const char* b, const char* e, const char* extra, char* out) {
+		return __atomic_load_n(&escaper, __ATOMIC_RELAXED)(b, e, extra, out);
+	}
+
+	char* unescapeBytes(const char* b, const char* e, char* out) {
+		return __atomic_load_n(&unescaper, __ATOMIC_RELAXED)(b, e, out);
+	}
+
+	size_t coderKernels(const CoderKernel*& kernels) {
+		kernels = coders;
+		return coderCount();
+	}
+
+} // namespace httplib
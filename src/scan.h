@@ -0,0 +1,40 @@
+#ifndef httplib_src_scan_h
+#define httplib_src_scan_h
+
+#include "httplib.h"
+
+namespace httplib {
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Bulk byte scanners used by the parsers.  Each returns the first byte in [b, e) that stops the scan, or
+	//-- e if there is none.  The implementation (AVX2, SSE4.2 or scalar) is picked once at startup.
+
+	const char* scanToken(const char* b, const char* e);
+	const char* scanFieldValue(const char* b, const char* e);
+
+	// Finds the "\r\n\r\n" that ends a header block, returns a pointer to its first byte or e.
+	const char* scanHeaderEnd(const char* b, const char* e);
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Percent-encoding kernels, picked the same way.  Runs that need no work are copied in bulk.  Both
+	//-- write to out and return the end of what they wrote.
+
+	// Writes %XX for each byte that chartype::needsEscape() or that is in extra; out needs room for three
+	// times the input.
+	char* escapeBytes(const char* b, const char* e, const char* extra, char* out);
+
+	// Decodes each %XX; out needs room for the input.  Returns 0 on a malformed escape.
+	char* unescapeBytes(const char* b, const char* e, char* out);
+
+	// The kernels this CPU can run, scalar reference first, so they can be checked against each other.
+	struct CoderKernel {
+		const char* name;
+		char* (*escape)(const char* b, const char* e, const char* extra, char* out);
+		char* (*unescape)(const char* b, const char* e, char* out);
+	};
+
+	size_t coderKernels(const CoderKernel*& kernels);
+
+}
+
+#endif // httplib_src_scan_h
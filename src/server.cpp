@@ -1,6 +1,10 @@
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
 #include <iostream>
 #include <limits>
+#include <algorithm>
 
 #include "server.h"
 #include "parser.h"
@@ -11,62 +15,189 @@ namespace httplib {
 	//--------------------------------------------------------------------------------------------------------------
 	//--
 
-	ServerRequest::ServerRequest() {
+	ServerRequest::ServerRequest(bool z) : zeroCopy(z), coalesceThreshold(0) {
 		clear();
 	}
 
 	void ServerRequest::clear() {
 		state = RecvRequestHeader;
 		need100 = false;
+		headRequest = false;
+		closeConnection = false;
+		legacyKeepAlive = false;
 
 		requestHdr.clear();
+		requestView.clear();
+		requestTarget.clear();
+		tailViews.clear();
 		requestParser.clear();
 		chunkParser.clear();
 		tailParser.clear();
 	}
 
-	void ServerRequest::setupRequestBody() {
-		uint64_t contentlength;
+	void ServerRequest::setLimits(const ParserLimits& limits) {
+		requestParser.limits = limits;
+		tailParser.limits = limits;
+	}
+
+	void ServerRequest::setCoalescing(size_t threshold) {
+		coalesceThreshold = threshold;
+	}
+
+	static void throwParseError(ParseError why, const char* what) {
+		switch (why) {
+		case ParseUriTooLong :
+			throw HttpStatusError(414, "Request URI too long");
+		case ParseHeaderTooLarge :
+			throw HttpStatusError(431, "Request header fields too large");
+		default :
+			throw HttpStatusError(400, string("Invalid ") + what);
+		}
+	}
+
+	// A body's length has to be read the way any proxy in front of this server reads it, or a request can
+	// hide another one in its body.  So Content-Length is digits only and Transfer-Encoding has to end
+	// with a single chunked.
+
+	template <typename Value> static uint64_t parseContentLength(const Value& value) {
+		const char* b = value.data();
+		const char* e = b + value.size();
+		if (b == e)
+			throw HttpStatusError(400, "Invalid Content-Length");
+		uint64_t v = 0;
+		for (; b != e; ++b) {
+			if (!chartype::isDigit(*b) || v > (~uint64_t(0) - (*b - '0')) / 10)
+				throw HttpStatusError(400, "Invalid Content-Length");
+			v = v * 10 + (*b - '0');
+		}
+		return v;
+	}
+
+	// Counts the chunked codings of one Transfer-Encoding value and notes whether the last one is chunked.
+	template <typename Value> static void scanCodings(const Value& value, int& chunked, bool& lastchunked) {
+		const char* b = value.data();
+		const char* e = b + value.size();
+		while (b != e) {
+			b = skipWhite(b, e);
+			const char* t = b;
+			while (b != e && *b != ',' && *b != ';' && *b != ' ' && *b != '\t')
+				++b;
+			StringRef coding(t, b - t);
+			b = skipPastComma(b, e);
+			if (coding.empty())
+				continue;
+			lastchunked = iCaseEqual(coding, "chunked");
+			if (lastchunked)
+				++chunked;
+		}
+	}
+
+	template <typename Request> void ServerRequest::setupRequestBody(const Request& header) {
+		uint64_t contentlength = 0;
 		bool havelength = false;
-		bool havechunked = false;
+		bool havecoding = false;
+		int chunked = 0;
+		bool lastchunked = false;
 		bool have100continue = false;
-		for (HttpHeaders::const_iterator i = requestHdr.headers.begin(); i != requestHdr.headers.end(); ++i) {
-			if (iCaseEqual(i->name, "Transfer-Encoding")) {
-				if (!iCaseEqual(i->value, "identity"))
-					havechunked = true;
-			}
-			else if (iCaseEqual(i->name, "Content-Length")) {
-				parseInteger(i->value.begin(), i->value.end(), contentlength);
+		bool haveclose = false;
+		bool havekeepalive = false;
+		for (typename Request::Headers::const_iterator i = header.headers.begin(); i != header.headers.end(); ++i) {
+			switch (i->id) {
+			case HeaderConnection :
+				if (hasCsvValue(i->value.begin(), i->value.end(), "close"))
+					haveclose = true;
+				if (hasCsvValue(i->value.begin(), i->value.end(), "keep-alive"))
+					havekeepalive = true;
+				break;
+			case HeaderTransferEncoding :
+				scanCodings(i->value, chunked, lastchunked);
+				havecoding = true;
+				break;
+			case HeaderContentLength :
+				if (!havelength)
+					contentlength = parseContentLength(i->value);
+				else if (parseContentLength(i->value) != contentlength)
+					throw HttpStatusError(400, "Conflicting Content-Length headers");
 				havelength = true;
-			}
-			else if (iCaseEqual(i->name, "Expect")) {
+				break;
+			case HeaderExpect :
 				if (iCaseEqual(i->value, "100-continue"))
 					have100continue = true;
+				break;
+			default :
+				break;
 			}
 		}
 
+		if (havecoding && (!lastchunked || chunked != 1))
+			throw HttpStatusError(400, "Unsupported Transfer-Encoding");
+
 		transferLeft = 0;
 		transferMode = BodyTransferIdentity;
-		if (havechunked)
+		if (havecoding)
 			transferMode = BodyTransferChunked;
 		else if (havelength)
 			transferLeft = contentlength;
 
-		headRequest = requestHdr.method == "HEAD";
+		headRequest = header.methodid == MethodHead;
+
+		// HTTP/1.1 connections persist unless either side says close, older ones only when asked to.
+		bool http11 = header.versionmajor > 1 || (header.versionmajor == 1 && header.versionminor >= 1);
+		closeConnection = haveclose || (!http11 && !havekeepalive);
+		legacyKeepAlive = !http11 && havekeepalive && !haveclose;
+
+		// Transfer-Encoding wins, but whoever sent both can't be trusted with another request.
+		if (havecoding && havelength) {
+			closeConnection = true;
+			legacyKeepAlive = false;
+		}
 
 		need100 = have100continue;
 	}
 
+	bool ServerRequest::shouldClose() {
+		return closeConnection;
+	}
+
+	bool ServerRequest::isResponding() {
+		return state == SendResponseHeader || state == SendResponseBody;
+	}
+
+	bool ServerRequest::isFinished() {
+		return state == ResponseFinished;
+	}
+
 	int ServerRequest::feed(const char * f, int s) {
 		const char *b = f;
 		const char *e = f + s;
+		for (;;) {
+			if (state == ResponseFinished) {
+				if (b == e || closeConnection)
+					break;
+				clear();
+			}
+			b = feedRequest(b, e);
+			if (state != ResponseFinished)
+				break;
+		}
+		return b - f;
+	}
+
+	const char* ServerRequest::feedRequest(const char* b, const char* e) {
 		while (b != e && state == RecvRequestHeader) {
-			b = requestParser.parse(b, e, requestHdr);
+			b = zeroCopy ? requestParser.parse(b, e, requestView) : requestParser.parse(b, e, requestHdr);
 			if (requestParser.isBad())
-				throw HttpError("Invalid request header");
+				throwParseError(requestParser.parseError(), "request header");
 
-			if (requestParser.isDone()) {
-				setupRequestBody();
+			if (requestParser.isDone() && zeroCopy) {
+				setupRequestBody(requestView);
+				requestTarget.parse(requestView.uri);
+				state = RecvRequestBody;
+				request(requestView);
+			}
+			else if (requestParser.isDone()) {
+				setupRequestBody(requestHdr);
+				requestTarget.parse(requestHdr.uri);
 				state = RecvRequestBody;
 				request(requestHdr);
 			}
@@ -87,6 +218,8 @@ namespace httplib {
 			else if (b != e) {
 				if (!chunkParser.isDone()) {
 					b = chunkParser.parse(b, e, transferLeft);
+					if (chunkParser.isBad())
+						throwParseError(chunkParser.parseError(), "chunk header");
 					if (!chunkParser.isDone()) break;
 					if (transferLeft == 0) {
 						state = RecvTailHeaders;
@@ -98,7 +231,7 @@ namespace httplib {
 				transferLeft -= l;
 				b += l;
 				if (transferLeft == 0)
-					chunkParser.clear();
+					chunkParser.nextChunk();
 				recv(b - l, l);
 			}
 			if (b == e)
@@ -106,77 +239,158 @@ namespace httplib {
 		}
 
 		while (b != e && state == RecvTailHeaders) {
-			b = tailParser.parse(b, e, requestHdr.headers);
+			b = zeroCopy ? tailParser.parse(b, e, tailViews) : tailParser.parse(b, e, requestHdr.headers);
+			if (tailParser.isBad())
+				throwParseError(tailParser.parseError(), "trailer");
 			if (tailParser.isDone()) {
 				state = SendResponseHeader;
 				end();
 			}
 		}
 
-		return b - f;
+		return b;
 	}
 
-	void ServerRequest::beginResponse(const ResponseHeader& response, Buffers& buffers, uint64_t knownsize) {
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	static const char serverLine[] = "Server: httplib 0.0\r\n";
+	static const char chunkedLine[] = "Transfer-Encoding: chunked\r\n";
+	static const char identityLine[] = "Transfer-Encoding: identity\r\n";
+	static const char closeLine[] = "Connection: close\r\n";
+	static const char keepAliveLine[] = "Connection: keep-alive\r\n";
+	static const char contentLengthName[] = "Content-Length: ";
+
+	template <size_t N> static iovec lineBuffer(const char (&line)[N]) {
+		iovec r = { (void*)line, N - 1 };
+		return r;
+	}
+
+	static uint64_t bodySize(const iovec* vec, int c) {
+		uint64_t l = 0;
+		for (int i = 0; i < c; ++i) l += vec[i].iov_len;
+		return l;
+	}
+
+	ResponseTemplate::ResponseTemplate() : code(500), contentLength(0), emptyBody(false), haveDate(false),
+		haveServer(false), haveLength(false), haveChunked(false), haveIdentity(false), haveConnection(false),
+		haveConnectionClose(false) {
+	}
+
+	ResponseTemplate::ResponseTemplate(const ResponseHeader& header) {
+		assign(header);
+	}
+
+	void ResponseTemplate::assign(const ResponseHeader& header) {
+		scan(header);
+
+		iovec status = statusLineBuffer(code);
+		if (status.iov_base != 0)
+			block.assign((const char*)status.iov_base, status.iov_len);
+		else
+			block = "HTTP/1.1 " + decSize(code) + " " + responseCodePhrase(code) + "\r\n";
+		if (!haveServer)
+			block += serverLine;
+		for (HttpHeaders::const_iterator i = header.headers.begin(); i != header.headers.end(); ++i)
+			block += i->name + ": " + i->value + "\r\n";
+	}
+
+	void ResponseTemplate::scan(const ResponseHeader& response) {
+		code = response.code;
+		contentLength = 0;
+		haveDate = false;
+		haveServer = false;
+		haveLength = false;
+		haveChunked = false;
+		haveIdentity = false;
+		haveConnection = false;
+		haveConnectionClose = false;
 
-		uint64_t contentlength;
-		bool havedate = false;
-		bool haveserver = false;
-		bool havelength = false;
-		bool havechunked = false;
-		bool haveidentity = false;
-		bool haveencoding = false;
-		bool haveconnectionclose = false;
 		for (HttpHeaders::const_iterator i = response.headers.begin(); i != response.headers.end(); ++i) {
-			if (iCaseEqual(i->name, "Transfer-Encoding")) {
-				haveencoding = true;
+			switch (lookupHeader(i->name)) {
+			case HeaderTransferEncoding :
 				if (hasCsvValue(i->value.begin(), i->value.end(), "chunked"))
-					havechunked = true;
+					haveChunked = true;
 				if (hasCsvValue(i->value.begin(), i->value.end(), "identity"))
-					haveidentity = true;
-			}
-			else if (iCaseEqual(i->name, "Content-Length")) {
-				if (havelength)
+					haveIdentity = true;
+				break;
+			case HeaderContentLength :
+				if (haveLength)
 					throw HttpError("Duplicate Content-Length header");
-				parseInteger(i->value.begin(), i->value.end(), contentlength);
-				havelength = true;
-			}
-			else if (iCaseEqual(i->name, "Server")) {
-				haveserver = true;
-			}
-			else if (iCaseEqual(i->name, "Connection")) {
-				if (iCaseEqual(i->value, "close"))
-					haveconnectionclose = true;
-			}
-			else if (iCaseEqual(i->name, "Date")) {
-				havedate = true;
+				parseInteger(i->value.begin(), i->value.end(), contentLength);
+				haveLength = true;
+				break;
+			case HeaderServer :
+				haveServer = true;
+				break;
+			case HeaderConnection :
+				haveConnection = true;
+				if (hasCsvValue(i->value.begin(), i->value.end(), "close"))
+					haveConnectionClose = true;
+				break;
+			case HeaderDate :
+				haveDate = true;
+				break;
+			default :
+				break;
 			}
 		}
 
-		bool emptyresponse = response.code == 204 || response.code == 304 || response.code / 100 == 1;
+		emptyBody = code == 204 || code == 304 || code / 100 == 1;
 
-		if ((havelength && havechunked) || (havechunked && haveidentity))
+		if ((haveLength && haveChunked) || (haveChunked && haveIdentity))
 			throw HttpError("Inconsistent Transfer-Encoding headers");
 
-		if (haveidentity && knownsize == ~uint64_t(0) && !havelength)
+		if (emptyBody && haveChunked)
+			throw HttpError("chunked mode not allowed for empty response");
+
+		if (code < 100 || code >= 1000)
+			throw HttpError("invalid resposne code");
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	void ServerRequest::beginResponse(const ResponseHeader& response, Buffers& buffers, uint64_t knownsize) {
+		ResponseTemplate t;
+		t.scan(response);
+
+		buffers.clear();
+		buffers.reserve(response.headers.size() * 4 + 8);
+		iovec status = statusLineBuffer(response.code);
+		if (status.iov_base == 0) {
+			responseLine = "HTTP/1.1 " + decSize(response.code) + " " + responseCodePhrase(response.code) + "\r\n";
+			status = toBuffer(responseLine);
+		}
+		buffers.push_back(status);
+		if (!t.haveServer)
+			buffers.push_back(lineBuffer(serverLine));
+		toBuffers(response.headers, buffers);
+		frameResponse(t, buffers, knownsize);
+	}
+
+	void ServerRequest::beginResponse(const ResponseTemplate& t, Buffers& buffers, uint64_t knownsize) {
+		buffers.clear();
+		buffers.push_back(toBuffer(t.block));
+		frameResponse(t, buffers, knownsize);
+	}
+
+	// Picks the transfer mode for this body and adds the headers that vary between responses.
+	void ServerRequest::frameResponse(const ResponseTemplate& t, Buffers& buffers, uint64_t knownsize) {
+		if (t.haveIdentity && knownsize == ~uint64_t(0) && !t.haveLength)
 			throw HttpError("Identity content without known body size");
 
-		if (havelength && knownsize != ~uint64_t(0) && contentlength != knownsize)
+		if (t.haveLength && knownsize != ~uint64_t(0) && t.contentLength != knownsize)
 			throw HttpError("Content-length header doesn't match body size");
 
-		if (emptyresponse && knownsize != ~uint64_t(0) && knownsize != 0)
+		if (t.emptyBody && knownsize != ~uint64_t(0) && knownsize != 0)
 			throw HttpError("message body not allowed");
 
-		if (emptyresponse && havechunked)
-			throw HttpError("chunked mode not allowed for empty response");
-
-		if (response.code < 100 || response.code >= 1000)
-			throw HttpError("invalid resposne code");
-
-		if (!havechunked && havelength) {
+		if (!t.haveChunked && t.haveLength) {
 			transferMode = BodyTransferIdentity;
-			transferLeft = contentlength;
+			transferLeft = t.contentLength;
 		}
-		else if (!havechunked && knownsize != ~uint64_t(0)) {
+		else if (!t.haveChunked && knownsize != ~uint64_t(0)) {
 			transferMode = BodyTransferIdentity;
 			transferLeft = knownsize;
 		}
@@ -189,44 +403,70 @@ namespace httplib {
 			transferLeft = 0;
 		}
 
-		if (!haveserver)
-			extraHeaders.push_back(HttpHeader("Server", "httplib 0.0"));
-
-		if (transferMode == BodyTransferChunked && !havechunked)
-			extraHeaders.push_back(HttpHeader("Transfer-Encoding", "chunked"));
-
-		if (transferMode == BodyTransferIdentity && !haveidentity)
-			extraHeaders.push_back(HttpHeader("Transfer-Encoding", "identity"));
+		if (transferMode == BodyTransferChunked && !t.haveChunked)
+			buffers.push_back(lineBuffer(chunkedLine));
+
+		if (transferMode == BodyTransferIdentity && !t.haveIdentity)
+			buffers.push_back(lineBuffer(identityLine));
+
+		if (transferMode == BodyTransferIdentity && !t.haveLength && !t.emptyBody && knownsize != ~uint64_t(0)) {
+			char* p = contentLengthLine;
+			memcpy(p, contentLengthName, sizeof(contentLengthName) - 1);
+			p += sizeof(contentLengthName) - 1;
+			p += decSize(knownsize, p);
+			*p++ = '\r';
+			*p++ = '\n';
+			iovec v = { contentLengthLine, size_t(p - contentLengthLine) };
+			buffers.push_back(v);
+		}
 
-		if (transferMode == BodyTransferIdentity && !havelength && !emptyresponse && knownsize != ~uint64_t(0))
-			extraHeaders.push_back(HttpHeader("Content-Length", decSize(knownsize)));
+		if (!t.haveDate)
+			buffers.push_back(dateLineBuffer());
 
-		if (!havedate)
-			extraHeaders.push_back(HttpHeader("Date", dateStr()));
+		if (t.haveConnectionClose)
+			closeConnection = true;
+		else if (closeConnection && !t.haveConnection)
+			buffers.push_back(lineBuffer(closeLine));
+		else if (legacyKeepAlive && !t.haveConnection)
+			buffers.push_back(lineBuffer(keepAliveLine));
 
-		responseLine = "HTTP/1.1 " + decSize(response.code) + " " + responseCodePhrase(response.code) + "\r\n";
-		buffers.reserve((response.headers.size() + extraHeaders.size()) * 4 + 1);
-		buffers.push_back(toBuffer(responseLine));
-		toBuffers(extraHeaders, buffers);
-		toBuffers(response.headers, buffers);
 		buffers.push_back(blanklineBuffer());
 	}
 
 	void ServerRequest::response(const ResponseHeader& header) {
 		if (state != SendResponseHeader) throw HttpError("can't send response");
 
-		Buffers buffers;
-		beginResponse(header, buffers, ~uint64_t(0));
-		transmit(&buffers[0], buffers.size());
+		beginResponse(header, bodyParts, ~uint64_t(0));
+		emit(&bodyParts[0], bodyParts.size());
+		state = SendResponseBody;
+	}
+
+	void ServerRequest::response(const ResponseTemplate& t) {
+		if (state != SendResponseHeader) throw HttpError("can't send response");
+
+		beginResponse(t, bodyParts, ~uint64_t(0));
+		emit(&bodyParts[0], bodyParts.size());
 		state = SendResponseBody;
 	}
 
 	void ServerRequest::send(const iovec* vec, int c) {
-		Buffers buffers;
-		uint64_t l = bodyBuffers(transferMode == BodyTransferChunked, chunkLines, vec, c, buffers);
-		if (transferMode == BodyTransferIdentity && l > transferLeft)
-			throw HttpError("body longer than specified size");
-		transmit(&buffers[0], buffers.size());
+		if (headRequest)
+			return;
+
+		if (transferMode == BodyTransferIdentity) {
+			uint64_t l = bodySize(vec, c);
+			if (l > transferLeft)
+				throw HttpError("body longer than specified size");
+			transferLeft -= l;
+			if (l != 0)
+				emit(vec, c);
+			return;
+		}
+
+		bodyParts.clear();
+		bodyBuffers(true, chunkSize, vec, c, bodyParts);
+		if (!bodyParts.empty())
+			emit(&bodyParts[0], bodyParts.size());
 	}
 
 	void ServerRequest::send(const void * b, int s) {
@@ -239,38 +479,125 @@ namespace httplib {
 		send(&v, 1);
 	}
 
+	void ServerRequest::sendFile(int fd, uint64_t offset, uint64_t length) {
+		if (headRequest || length == 0)
+			return;
+
+		if (transferMode == BodyTransferIdentity) {
+			if (length > transferLeft)
+				throw HttpError("body longer than specified size");
+			transferLeft -= length;
+			emitFile(0, 0, fd, offset, length);
+			return;
+		}
+
+		iovec line[2] = { { chunkSize, hexSize(length, chunkSize) }, blanklineBuffer() };
+		iovec end = blanklineBuffer();
+		emitFile(line, 2, fd, offset, length);
+		emit(&end, 1);
+	}
+
 	void ServerRequest::finish() {
 		if (transferMode == BodyTransferIdentity) {
 			if (transferLeft != 0)
 				throw HttpError("body size mismatch");
 		}
-		else {
-			Buffers buffers;
-			buffers.push_back(chunkEndBuffer());
-			transmit(&buffers[0], buffers.size());
+		else if (!headRequest) {
+			iovec v = chunkEndBuffer();
+			emit(&v, 1);
 		}
 		state = ResponseFinished;
 	}
 
-	void ServerRequest::response(const ResponseHeader& header, const iovec* vec, int c) {
-		if (state != SendResponseHeader) throw HttpError("can't send response");
-
-		uint64_t l = 0;
-		for (int i = 0; i < c; ++i) l += vec[i].iov_len;
-
-		Buffers buffers;
-		beginResponse(header, buffers, l);
+	// Transmits the framed header in bodyParts together with the whole body.
+	void ServerRequest::completeResponse(const iovec* vec, int c) {
 		if (!headRequest) {
-			transferLeft -= bodyBuffers(transferMode == BodyTransferChunked, chunkLines, vec, c, buffers);
+			transferLeft -= bodyBuffers(transferMode == BodyTransferChunked, chunkSize, vec, c, bodyParts);
 			if (transferMode == BodyTransferChunked)
-				buffers.push_back(chunkEndBuffer());
+				bodyParts.push_back(chunkEndBuffer());
 			else if (transferLeft != 0)
 				throw HttpError("body side doesn't match size header");
 		}
-		transmit(&buffers[0], buffers.size());
+		emit(&bodyParts[0], bodyParts.size());
+		state = ResponseFinished;
+	}
+
+	void ServerRequest::response(const ResponseHeader& header, const iovec* vec, int c) {
+		if (state != SendResponseHeader) throw HttpError("can't send response");
+
+		beginResponse(header, bodyParts, bodySize(vec, c));
+		completeResponse(vec, c);
+	}
+
+	void ServerRequest::response(const ResponseTemplate& t, const iovec* vec, int c) {
+		if (state != SendResponseHeader) throw HttpError("can't send response");
+
+		beginResponse(t, bodyParts, bodySize(vec, c));
+		completeResponse(vec, c);
+	}
+
+	void ServerRequest::response(const ResponseHeader& header, int fd, uint64_t offset, uint64_t length) {
+		if (state != SendResponseHeader) throw HttpError("can't send response");
+
+		beginResponse(header, bodyParts, length);
+		if (headRequest || length == 0) {
+			if (transferMode == BodyTransferChunked && !headRequest)
+				bodyParts.push_back(chunkEndBuffer());
+			emit(&bodyParts[0], bodyParts.size());
+		}
+		else if (transferMode == BodyTransferChunked) {
+			iovec line[2] = { { chunkSize, hexSize(length, chunkSize) }, blanklineBuffer() };
+			bodyParts.insert(bodyParts.end(), line, line + 2);
+			iovec end[2] = { blanklineBuffer(), chunkEndBuffer() };
+			emitFile(&bodyParts[0], bodyParts.size(), fd, offset, length);
+			emit(end, 2);
+		}
+		else
+			emitFile(&bodyParts[0], bodyParts.size(), fd, offset, length);
+		transferLeft = 0;
 		state = ResponseFinished;
 	}
 
+	void ServerRequest::transmitFile(const iovec* vec, int c, int fd, uint64_t offset, uint64_t length) {
+		if (c != 0)
+			transmit(vec, c);
+
+		char buffer[16 * 1024];
+		while (length != 0) {
+			ssize_t n = ::pread(fd, buffer, size_t(std::min(length, uint64_t(sizeof(buffer)))), offset);
+			if (n == -1 && errno == EINTR)
+				continue;
+			if (n == -1)
+				throw HttpError("Failed to read file: " + string(strerror(errno)));
+			if (n == 0)
+				throw HttpError("File shorter than the response body");
+			iovec v = { buffer, size_t(n) };
+			transmit(&v, 1);
+			offset += n;
+			length -= n;
+		}
+	}
+
+	// Hands parts to the transport, coalesced when setCoalescing() asked for it.
+	void ServerRequest::emit(const iovec* vec, int c) {
+		if (coalesceThreshold == 0)
+			transmit(vec, c);
+		else {
+			coalesceBuffers(vec, c, coalesceThreshold, coalesceScratch, coalesceParts);
+			if (!coalesceParts.empty())
+				transmit(&coalesceParts[0], coalesceParts.size());
+		}
+	}
+
+	void ServerRequest::emitFile(const iovec* vec, int c, int fd, uint64_t offset, uint64_t length) {
+		if (coalesceThreshold == 0 || c == 0)
+			transmitFile(vec, c, fd, offset, length);
+		else {
+			coalesceBuffers(vec, c, coalesceThreshold, coalesceScratch, coalesceParts);
+			transmitFile(coalesceParts.empty() ? 0 : &coalesceParts[0], coalesceParts.size(), fd, offset, length);
+		}
+	}
+
 	void ServerRequest::response(const ResponseHeader& header, const char * b, int s) {
 		iovec v = { (void*)b, s };
 		response(header, &v, 1);
@@ -281,4 +608,14 @@ namespace httplib {
 		response(header, &v, 1);
 	}
 
+	void ServerRequest::response(const ResponseTemplate& t, const char * b, int s) {
+		iovec v = { (void*)b, size_t(s) };
+		response(t, &v, 1);
+	}
+
+	void ServerRequest::response(const ResponseTemplate& t, const string& str) {
+		iovec v = { (void*)&str[0], str.size() };
+		response(t, &v, 1);
+	}
+
 } // namespace httplib
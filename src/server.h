@@ -7,19 +7,78 @@
 #include "request.h"
 #include "parser.h"
 #include "header.h"
+#include "uri.h"
 
 namespace httplib {
 
+	//---------------------------------------------------------------------------------------------------------
+	//-- A response header validated and serialized once, for handlers that answer many requests alike.  Only
+	//-- the lines that vary per response (framing, Date, Connection) are added when it's sent.
+
+	struct ResponseTemplate {
+		ResponseTemplate();
+		explicit ResponseTemplate(const ResponseHeader& header);
+
+		void assign(const ResponseHeader& header);
+
+		// Reads the flags below from the headers and checks what doesn't depend on the body.
+		void scan(const ResponseHeader& header);
+
+		int code;
+		uint64_t contentLength;
+		bool emptyBody;
+		bool haveDate;
+		bool haveServer;
+		bool haveLength;
+		bool haveChunked;
+		bool haveIdentity;
+		bool haveConnection;
+		bool haveConnectionClose;
+
+		// Status line, Server unless given and the headers.
+		string block;
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//--
+
 	struct ServerRequest {
 
-		ServerRequest();
+		explicit ServerRequest(bool zeroCopy = false);
+		virtual ~ServerRequest() {}
 
 		void clear();
+		void setLimits(const ParserLimits& limits);
+
+		// With a threshold, header lines and body segments shorter than it are copied into one buffer per
+		// transmit() instead of passed as an iovec each; 0, the default, passes everything as it is.
+		void setCoalescing(size_t threshold);
 
+		// Consumes requests until one is waiting for its response, the connection has to close, or the input
+		// runs out.  A finished exchange is reset on the next feed, so pipelined requests are parsed from the
+		// same buffer; bytes that are not consumed should be fed again once the response is finished.
 		int feed(const char * b, int s);
 		virtual void transmit(const iovec* vec, int c) = 0;
 
+		// Writes vec, then length bytes of the file fd from offset.  The default reads the file and transmits
+		// it in pieces; socket transports send it without copying.  fd only has to stay open for the call.
+		virtual void transmitFile(const iovec* vec, int c, int fd, uint64_t offset, uint64_t length);
+
+		// Flow control for transports that queue what the socket doesn't take.  While congested() a streaming
+		// handler should hold off calling send(); writable() is called once the transport has caught up.
+		virtual bool congested() { return false; }
+		virtual void writable() {}
+
+		// The target of the current request split into components, set before request() is called.  It
+		// refers to the parsed header, so in zero copy mode it's only valid during request().
+		const UriView& target() const { return requestTarget; }
+
+		// In zero copy mode the trailers of a chunked request body, valid during end(); in copy mode they
+		// are appended to the headers request() was given.
+		const HeaderViews& trailers() const { return tailViews; }
+
 		virtual void request(RequestHeader& header) {}
+		virtual void request(RequestHeaderView& header) {}
 		virtual void recv(const char * b, int s) {}
 		virtual void end() {}
 
@@ -28,13 +87,23 @@ namespace httplib {
 		void send(const iovec* vec, int c);
 		void send(const void * b, int s);
 		void send(const string& str);
+		void sendFile(int fd, uint64_t offset, uint64_t length);
 		void finish();
 
 		void response(const ResponseHeader& header, const iovec* vec, int c);
 		void response(const ResponseHeader& header, const char * b, int s);
 		void response(const ResponseHeader& header, const string& str);
+		void response(const ResponseHeader& header, int fd, uint64_t offset, uint64_t length);
 
+		void response(const ResponseTemplate& t);
+		void response(const ResponseTemplate& t, const iovec* vec, int c);
+		void response(const ResponseTemplate& t, const char * b, int s);
+		void response(const ResponseTemplate& t, const string& str);
+
+		// True when the connection has to be closed once the current response is finished.
 		bool shouldClose();
+		bool isResponding();
+		bool isFinished();
 
 	private :
 
@@ -47,20 +116,40 @@ namespace httplib {
 			ResponseFinished,
 		};
 
+		const char* feedRequest(const char* b, const char* e);
 		void beginResponse(const ResponseHeader& request, Buffers& buffers, uint64_t knownsize);
-		void setupRequestBody();
-
+		void beginResponse(const ResponseTemplate& t, Buffers& buffers, uint64_t knownsize);
+		void frameResponse(const ResponseTemplate& t, Buffers& buffers, uint64_t knownsize);
+		void completeResponse(const iovec* vec, int c);
+		void emit(const iovec* vec, int c);
+		void emitFile(const iovec* vec, int c, int fd, uint64_t offset, uint64_t length);
+		template <typename Request> void setupRequestBody(const Request& header);
+
+		bool zeroCopy;
 		bool need100;
 		bool headRequest;
+		bool closeConnection;
+		bool legacyKeepAlive;
 		RequestState state;
 		BodyTransferMode transferMode;
 		uint64_t transferLeft;
 
-		HttpHeaders extraHeaders;
-		list<string> chunkLines;
 		string responseLine;
+		char contentLengthLine[40];
+
+		// Response header and body framing, reused once each part has been transmitted so responses don't
+		// allocate.
+		Buffers bodyParts;
+		char chunkSize[16];
+
+		size_t coalesceThreshold;
+		vector<char> coalesceScratch;
+		Buffers coalesceParts;
 
 		RequestHeader requestHdr;
+		RequestHeaderView requestView;
+		UriView requestTarget;
+		HeaderViews tailViews;
 		RequestParser requestParser;
 		ChunkParser chunkParser;
 		TailParser tailParser;
@@ -0,0 +1,113 @@
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "shard.h"
+
+namespace httplib {
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	static int socketPort(int fd) {
+		sockaddr_storage address;
+		socklen_t length = sizeof(address);
+		if (getsockname(fd, (sockaddr*)&address, &length) == -1)
+			throw HttpError("Failed to get listening port: " + string(strerror(errno)));
+		if (address.ss_family == AF_INET6)
+			return ntohs(((sockaddr_in6*)&address)->sin6_port);
+		return ntohs(((sockaddr_in*)&address)->sin_port);
+	}
+
+	ShardedServer::ShardedServer() : pinThreads(false), backlog(1024), listenPort(0) {
+	}
+
+	ShardedServer::~ShardedServer() {
+		stop();
+	}
+
+	int ShardedServer::port() {
+		return listenPort;
+	}
+
+	void ShardedServer::start(const char* host, const char* service, int threads) {
+		if (!shards.empty())
+			throw HttpError("server already started");
+
+		try {
+			shards.resize(threads);
+			for (int i = 0; i < threads; ++i) {
+				char port[16];
+				snprintf(port, sizeof(port), "%d", listenPort);
+				shards[i].server = this;
+				shards[i].index = i;
+				shards[i].fd = listenSocket(host, i == 0 ? service : port, backlog, true);
+				if (i == 0)
+					listenPort = socketPort(shards[i].fd);
+				shards[i].reactor = createReactor(i);
+				shards[i].reactor->listen(shards[i].fd);
+			}
+
+			long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+			for (int i = 0; i < threads; ++i) {
+				pthread_attr_t attr;
+				pthread_attr_init(&attr);
+				if (pinThreads && cpus > 0) {
+					cpu_set_t set;
+					CPU_ZERO(&set);
+					CPU_SET(i % cpus, &set);
+					pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+				}
+				int err = pthread_create(&shards[i].thread, &attr, runShard, &shards[i]);
+				pthread_attr_destroy(&attr);
+				if (err != 0)
+					throw HttpError("Failed to start server thread: " + string(strerror(err)));
+				shards[i].started = true;
+			}
+		}
+		catch (...) {
+			stop();
+			throw;
+		}
+	}
+
+	void ShardedServer::stop() {
+		for (vector<Shard>::iterator i = shards.begin(); i != shards.end(); ++i)
+			if (i->started)
+				i->reactor->stop();
+
+		for (vector<Shard>::iterator i = shards.begin(); i != shards.end(); ++i) {
+			if (i->started)
+				pthread_join(i->thread, 0);
+			delete i->reactor;
+			if (i->fd != -1)
+				close(i->fd);
+		}
+
+		shards.clear();
+		listenPort = 0;
+	}
+
+	void* ShardedServer::runShard(void* shard) {
+		// A shard whose loop fails stops on its own and the others keep serving.  Its listener goes with it,
+		// or the kernel would go on queueing connections there that nobody accepts.  The fd is only read
+		// again by stop(), after joining this thread.
+		Shard* s = static_cast<Shard*>(shard);
+		try {
+			s->reactor->run();
+		}
+		catch (std::exception& err) {
+			shutdown(s->fd, SHUT_RDWR);
+			close(s->fd);
+			s->fd = -1;
+			s->server->shardFailed(s->index, err);
+		}
+		return 0;
+	}
+
+} // namespace httplib
@@ -0,0 +1,62 @@
+#ifndef httplib_src_shard_h
+#define httplib_src_shard_h
+
+#include <pthread.h>
+
+#include "httplib.h"
+#include "reactor.h"
+
+namespace httplib {
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Runs one Reactor per thread.  Every thread has its own SO_REUSEPORT listening socket on the same port,
+	//-- so the kernel spreads new connections and a connection never leaves the thread that accepted it.
+	//-- Nothing is shared between the shards: connections, read buffers and requests all belong to one
+	//-- reactor.
+
+	struct ShardedServer {
+		ShardedServer();
+		virtual ~ShardedServer();
+
+		// A service of "0" picks a free port for the first shard and the rest share it.
+		void start(const char* host, const char* service, int threads);
+		void stop();
+
+		int port();
+
+		// Called on the starting thread for each shard; the reactor is deleted after its thread has stopped.
+		virtual Reactor* createReactor(int shard) = 0;
+
+		// Called on the shard's thread when its loop fails.  Its listening socket is closed by then, so the
+		// kernel hands new connections to the other shards.  Servers that override it call stop() in their
+		// own destructor.
+		virtual void shardFailed(int shard, const std::exception& err) {}
+
+		bool pinThreads;		// shard n runs on cpu n modulo the online cpu count
+		int backlog;
+
+	private :
+
+		ShardedServer(const ShardedServer&);
+		ShardedServer& operator=(const ShardedServer&);
+
+		struct Shard {
+			Shard() : server(0), index(0), reactor(0), fd(-1), started(false) {}
+
+			ShardedServer* server;
+			int index;
+			Reactor* reactor;
+			int fd;
+			bool started;
+			pthread_t thread;
+		};
+
+		static void* runShard(void* shard);
+
+		vector<Shard> shards;
+		int listenPort;
+	};
+
+}
+
+#endif // httplib_src_shard_h
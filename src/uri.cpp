@@ -1,66 +1,188 @@
 
+#include <string.h>
+
 #include "uri.h"
 #include "parser.h"
 
 namespace httplib {
 
+	// Splits with UriView, then decodes into the members so their storage is reused.
 	void Uri::parse(const string& uri) {
+		UriView view(uri);
+		if (!UriView::decode(view.scheme, scheme) || !UriView::decode(view.authority, authority) ||
+			!UriView::decode(view.path, path))
+			throw HttpError("invalid escape sequence in uri " + uri);
+		query.assign(view.query.data(), view.query.size());
+		fragment.assign(view.fragment.data(), view.fragment.size());
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	void UriView::parse(const StringRef& uri) {
+		clear();
+		const char* b = uri.begin();
+		const char* e = uri.end();
+		const char* c = b;
 
 		// Check for a scheme.
-		string::size_type b = 0;
-		scheme.clear();
-		string::size_type c = uri.find_first_of(":/?#", b);
-		if (c != string::npos && uri[c] == ':') {
+		while (c != e && *c != ':' && *c != '/' && *c != '?' && *c != '#')
+			++c;
+		if (c != e && *c == ':') {
+			scheme = StringRef(b, c - b);
 			b = c + 1;
-			scheme = unescapeString(uri.substr(0, c));
 		}
 
 		// Check for an authority.
-		authority.clear();
-		if (b + 1 < uri.size() && uri[b] == '/' && uri[b + 1] == '/') {
-			c = b + 2;
-			b = uri.find_first_of("/?#", c);
-			authority = unescapeString(uri.substr(c, b - c));
+		if (e - b >= 2 && b[0] == '/' && b[1] == '/') {
+			c = b += 2;
+			while (b != e && *b != '/' && *b != '?' && *b != '#')
+				++b;
+			authority = StringRef(c, b - c);
 		}
 
 		// extract the path component.
-		path.clear();
-		if (b < uri.size()) {
-			c = b;
-			b = uri.find_first_of("?#", c);
-			path = unescapeString(uri.substr(c, b - c));
-		}
-		if (path.empty())
-			path = "/";
+		c = b;
+		while (b != e && *b != '?' && *b != '#')
+			++b;
+		path = c != b ? StringRef(c, b - c) : StringRef("/", 1);
 
 		// Check for a query
-		query.clear();
-		if (b < uri.size() && uri[b] == '?') {
-			c = b + 1;
-			b = uri.find('#', c);
-			query = uri.substr(c, b - c);
+		if (b != e && *b == '?') {
+			c = ++b;
+			while (b != e && *b != '#')
+				++b;
+			query = StringRef(c, b - c);
 		}
 
 		// Check for a fragment
-		fragment.clear();
-		if (b < uri.size() && uri[b] == '#') {
-			fragment = uri.substr(b + 1);
+		if (b != e && *b == '#')
+			fragment = StringRef(b + 1, e - b - 1);
+	}
+
+	bool UriView::escaped(const StringRef& component) {
+		return !component.empty() && memchr(component.data(), '%', component.size()) != 0;
+	}
+
+	bool UriView::decode(const StringRef& component, string& out) {
+		return unescapeString(component.begin(), component.end(), out);
+	}
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	bool QueryParams::next(StringRef& key, StringRef& value) {
+		while (b != e) {
+			const char* end = static_cast<const char*>(memchr(b, '&', e - b));
+			if (end == 0)
+				end = e;
+			const char* p = b;
+			b = end != e ? end + 1 : e;
+			if (p == end)
+				continue;
+			const char* eq = static_cast<const char*>(memchr(p, '=', end - p));
+			if (eq == 0) {
+				key = StringRef(p, end - p);
+				value = StringRef(end, 0);
+			}
+			else {
+				key = StringRef(p, eq - p);
+				value = StringRef(eq + 1, end - eq - 1);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	bool QueryParams::find(const StringRef& name, StringRef& value) const {
+		QueryParams i(*this);
+		StringRef key;
+		while (i.next(key, value))
+			if (matches(key, name))
+				return true;
+		return false;
+	}
+
+	size_t QueryParams::find(const StringRef* keys, size_t count, StringRef* values, bool* found) const {
+		for (size_t k = 0; k < count; ++k)
+			found[k] = false;
+		size_t n = 0;
+		QueryParams i(*this);
+		StringRef key, value;
+		while (n != count && i.next(key, value)) {
+			for (size_t k = 0; k < count; ++k) {
+				if (!found[k] && matches(key, keys[k])) {
+					values[k] = value;
+					found[k] = true;
+					++n;
+				}
+			}
+		}
+		return n;
+	}
+
+	bool QueryParams::decode(const StringRef& component, string& out) {
+		if (component.empty() || memchr(component.data(), '+', component.size()) == 0)
+			return unescapeString(component.begin(), component.end(), out);
+
+		// A '+' is a space, but an escaped one isn't, so '+' has to be handled while decoding.
+		out.resize(component.size());
+		size_t n = 0;
+		for (const char* i = component.begin(); i != component.end(); ++i) {
+			if (*i == '+')
+				out[n++] = ' ';
+			else if (*i != '%')
+				out[n++] = *i;
+			else if (component.end() - i < 3 || !chartype::isXDigit(i[1]) || !chartype::isXDigit(i[2])) {
+				out.clear();
+				return false;
+			}
+			else {
+				out[n++] = char(chartype::hexValue(i[1]) * 16 + chartype::hexValue(i[2]));
+				i += 2;
+			}
+		}
+		out.resize(n);
+		return true;
+	}
+
+	bool QueryParams::matches(const StringRef& component, const StringRef& key) {
+		// Decoding only ever shortens, so a shorter component can't match.
+		if (component.size() < key.size())
+			return false;
+		const char* i = component.begin();
+		const char* k = key.begin();
+		for (; i != component.end(); ++i, ++k) {
+			if (k == key.end())
+				return false;
+			char c = *i;
+			if (c == '+')
+				c = ' ';
+			else if (c == '%') {
+				if (component.end() - i < 3 || !chartype::isXDigit(i[1]) || !chartype::isXDigit(i[2]))
+					return false;
+				c = char(chartype::hexValue(i[1]) * 16 + chartype::hexValue(i[2]));
+				i += 2;
+			}
+			if (c != *k)
+				return false;
 		}
+		return k == key.end();
 	}
 
 	string Uri::format() {
 		string r;
 		if (!scheme.empty()) {
-			r.append(escapeStringExtra(scheme, ":/?#"));
+			appendEscaped(scheme.data(), scheme.data() + scheme.size(), ":/?#", r);
 			r.push_back(':');
 		}
 
 		if (!authority.empty()) {
 			r.append("//");
-			r.append(escapeString(authority));
+			appendEscaped(authority.data(), authority.data() + authority.size(), ":?#", r);
 		}
 
-		r.append(escapeString(path));
+		appendEscaped(path.data(), path.data() + path.size(), ":?#", r);
 
 		if (!query.empty()) {
 			r.push_back('?');
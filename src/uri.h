@@ -2,6 +2,7 @@
 #define httplib_src_uri_h
 
 #include "httplib.h"
+#include "header.h"
 
 namespace httplib {
 
@@ -41,6 +42,66 @@ namespace httplib {
 		string fragment;
 	};
 
+	//---------------------------------------------------------------------------------------------------------
+	//-- The components of a URI as views into it, found in one pass and left escaped.  Nothing is copied or
+	//-- decoded until decode() is asked for a component, so routing on a path prefix costs no allocation; a
+	//-- malformed escape makes decode() return false rather than throw.  The views are only as good as the
+	//-- string that was parsed.
+
+	struct UriView {
+		UriView() {}
+		explicit UriView(const StringRef& uri) { parse(uri); }
+
+		void clear() {
+			scheme.clear();
+			authority.clear();
+			path.clear();
+			query.clear();
+			fragment.clear();
+		}
+
+		void parse(const StringRef& uri);
+
+		// True when the component has escapes, so that it differs from its decoded form.
+		static bool escaped(const StringRef& component);
+		static bool decode(const StringRef& component, string& out);
+
+		StringRef scheme;
+		StringRef authority;
+		StringRef path;		// "/" when the URI has none
+		StringRef query;
+		StringRef fragment;
+	};
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- The parameters of a query string, as views into it in the order they appear: "a=1&b&c=" has a = "1",
+	//-- b = "" and c = "".  Keys and values stay encoded until decode() is asked for one, which turns '+'
+	//-- into a space and decodes %XX into a string whose storage it reuses.  Looking keys up compares them
+	//-- decoded without decoding them anywhere, so none of it allocates.
+
+	struct QueryParams {
+		QueryParams() : b(0), e(0) {}
+		explicit QueryParams(const StringRef& query) : b(query.begin()), e(query.end()) {}
+
+		// Takes the next parameter; false at the end.
+		bool next(StringRef& key, StringRef& value);
+
+		// Finds the first parameter named key.
+		bool find(const StringRef& key, StringRef& value) const;
+
+		// Looks up count keys in one pass, setting values[i] to the first value of keys[i] and found[i] to
+		// whether there was one; returns how many were found.
+		size_t find(const StringRef* keys, size_t count, StringRef* values, bool* found) const;
+
+		static bool decode(const StringRef& component, string& out);
+
+		// True when the encoded component decodes to key.
+		static bool matches(const StringRef& component, const StringRef& key);
+
+		const char* b;
+		const char* e;
+	};
+
 }
 
 #endif // httplib_src_uri_h
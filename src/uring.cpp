@@ -0,0 +1,404 @@
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+#define HTTPLIB_URING
+#endif
+#endif
+#endif
+
+namespace httplib {
+
+	//--------------------------------------------------------------------------------------------------------------
+	//--
+
+	Ring::Ring() : bufferSize(0), fd(-1), sqMap(MAP_FAILED), sqeMap(MAP_FAILED), cqMap(MAP_FAILED),
+		bufferRing(MAP_FAILED), bufferBase(0), reapedNext(0) {
+	}
+
+	Ring::~Ring() {
+		close();
+	}
+
+#ifdef HTTPLIB_URING
+
+	// Offset of the tail in a provided buffer ring, which overlays the reserved field of the first entry.
+	static const size_t bufferRingTail = 14;
+
+	static int uringSetup(unsigned entries, io_uring_params* params) {
+		return int(syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	static int uringEnter(int fd, unsigned submit, unsigned wait, unsigned flags, void* arg, size_t size) {
+		return int(syscall(__NR_io_uring_enter, fd, submit, wait, flags, arg, size));
+	}
+
+	static int uringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+		return int(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+	}
+
+	static void* mapRing(int fd, size_t size, off_t offset) {
+		return mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+	}
+
+	bool Ring::open(unsigned entries, unsigned buffers, size_t size) {
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		fd = uringSetup(entries, &params);
+		if (fd == -1)
+			return false;
+		if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+			close();
+			return false;
+		}
+
+		sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		sqeMapSize = params.sq_entries * sizeof(io_uring_sqe);
+		sqMap = mapRing(fd, sqMapSize, IORING_OFF_SQ_RING);
+		cqMap = mapRing(fd, cqMapSize, IORING_OFF_CQ_RING);
+		sqeMap = mapRing(fd, sqeMapSize, IORING_OFF_SQES);
+		if (sqMap == MAP_FAILED || cqMap == MAP_FAILED || sqeMap == MAP_FAILED) {
+			close();
+			return false;
+		}
+
+		char* sq = static_cast<char*>(sqMap);
+		sqHead = (unsigned*)(sq + params.sq_off.head);
+		sqTail = (unsigned*)(sq + params.sq_off.tail);
+		sqArray = (unsigned*)(sq + params.sq_off.array);
+		sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+		sqEntries = params.sq_entries;
+		sqLocalTail = *sqTail;
+		sqes = static_cast<io_uring_sqe*>(sqeMap);
+
+		char* cq = static_cast<char*>(cqMap);
+		cqHead = (unsigned*)(cq + params.cq_off.head);
+		cqTail = (unsigned*)(cq + params.cq_off.tail);
+		cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+		cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+		// The buffer ring and the buffers themselves live in one anonymous mapping.
+		bufferCount = buffers;
+		bufferSize = size;
+		bufferTail = 0;
+		bufferRingSize = buffers * sizeof(io_uring_buf) + buffers * size;
+		bufferRing = mmap(0, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (bufferRing == MAP_FAILED) {
+			close();
+			return false;
+		}
+		bufferBase = static_cast<char*>(bufferRing) + buffers * sizeof(io_uring_buf);
+
+		io_uring_buf_reg reg;
+		memset(&reg, 0, sizeof(reg));
+		reg.ring_addr = (unsigned long)bufferRing;
+		reg.ring_entries = buffers;
+		reg.bgid = 0;
+		if (uringRegister(fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+			close();
+			return false;
+		}
+		for (unsigned i = 0; i < buffers; ++i)
+			recycle(i);
+		publish();
+
+		if (!probeMultishotRecv()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	// Multishot receives came after the other features, so try one on a socket pair rather than guess from
+	// the kernel version.
+	bool Ring::probeMultishotRecv() {
+		int pair[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == -1)
+			return false;
+
+		receive(pair[0], 0);
+
+		bool supported = false;
+		Event event;
+		if (::write(pair[1], "x", 1) == 1) {
+			enter(1000);
+			if (complete(event)) {
+				supported = event.result == 1 && event.more;
+				if (event.buffer != -1)
+					recycle(event.buffer);
+			}
+		}
+
+		// Closing the peer ends the receive; wait for its last completion so nothing is left in flight.
+		::close(pair[1]);
+		while (supported) {
+			enter(1000);
+			if (!complete(event))
+				break;
+			if (event.buffer != -1)
+				recycle(event.buffer);
+			if (!event.more)
+				break;
+		}
+		::close(pair[0]);
+		publish();
+		return supported;
+	}
+
+	void Ring::accept(int fd, uint64_t data) {
+		io_uring_sqe* sqe = next();
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->fd = fd;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_CLOEXEC | SOCK_NONBLOCK;
+		sqe->user_data = data;
+	}
+
+	void Ring::receive(int fd, uint64_t data) {
+		io_uring_sqe* sqe = next();
+		sqe->opcode = IORING_OP_RECV;
+		sqe->fd = fd;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = 0;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->user_data = data;
+	}
+
+	void Ring::send(int fd, const msghdr* message, uint64_t data) {
+		io_uring_sqe* sqe = next();
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = fd;
+		sqe->addr = (unsigned long)message;
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->user_data = data;
+	}
+
+	void Ring::read(int fd, void* p, size_t size, uint64_t data) {
+		io_uring_sqe* sqe = next();
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->addr = (unsigned long)p;
+		sqe->len = unsigned(size);
+		sqe->off = (unsigned long long)-1;
+		sqe->user_data = data;
+	}
+
+	void Ring::poll(int fd, unsigned events, uint64_t data) {
+		io_uring_sqe* sqe = next();
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = fd;
+		sqe->poll32_events = events;
+		sqe->user_data = data;
+	}
+
+	void Ring::cancel(uint64_t target, uint64_t data) {
+		io_uring_sqe* sqe = next();
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = target;
+		sqe->user_data = data;
+	}
+
+	static void readEvent(const io_uring_cqe* cqe, Ring::Event& event) {
+		event.data = cqe->user_data;
+		event.result = cqe->res;
+		event.more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+		event.buffer = (cqe->flags & IORING_CQE_F_BUFFER) ? int(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+	}
+
+	bool Ring::complete(Event& event) {
+		if (reapedNext < reaped.size()) {
+			event = reaped[reapedNext++];
+			if (reapedNext == reaped.size()) {
+				reaped.clear();
+				reapedNext = 0;
+			}
+			return true;
+		}
+		io_uring_cqe* cqe = peek();
+		if (cqe == 0)
+			return false;
+		readEvent(cqe, event);
+		seen();
+		return true;
+	}
+
+	io_uring_sqe* Ring::next() {
+		// The kernel turns submissions away (EBUSY) while it holds completions the full completion queue had
+		// no room for.  Taking those off the queue lets enter() flush them and the submissions go in.
+		for (int tries = 0; sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries; ++tries) {
+			if (tries == 16)
+				throw HttpError("io_uring submission queue stays full");
+			reap();
+			enter(0);
+		}
+		unsigned index = sqLocalTail & sqMask;
+		io_uring_sqe* sqe = &sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqArray[index] = index;
+		++sqLocalTail;
+		return sqe;
+	}
+
+	void Ring::enter(int timeout) {
+		// Entries the kernel turned away before are still ahead of its head, so they go again.
+		__atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+		unsigned submit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+		// Asking for events without waiting also flushes completions held back for want of room.
+		unsigned flags = IORING_ENTER_GETEVENTS;
+		unsigned wait = 0;
+		__kernel_timespec ts;
+		io_uring_getevents_arg arg;
+		memset(&arg, 0, sizeof(arg));
+		if (timeout != 0 && peek() == 0 && reaped.empty()) {
+			flags |= IORING_ENTER_EXT_ARG;
+			wait = 1;
+			if (timeout > 0) {
+				ts.tv_sec = timeout / 1000;
+				ts.tv_nsec = (timeout % 1000) * 1000000LL;
+				arg.ts = (unsigned long)&ts;
+			}
+		}
+
+		if (submit == 0 && wait == 0)
+			return;
+		int r = uringEnter(fd, submit, wait, flags, wait ? &arg : 0, wait ? sizeof(arg) : 0);
+		if (r == -1 && errno != EINTR && errno != ETIME && errno != EAGAIN && errno != EBUSY)
+			throw HttpError("io_uring_enter failed: " + string(strerror(errno)));
+	}
+
+	void Ring::reap() {
+		Event event;
+		for (io_uring_cqe* cqe = peek(); cqe != 0; cqe = peek()) {
+			readEvent(cqe, event);
+			reaped.push_back(event);
+			seen();
+		}
+	}
+
+	io_uring_cqe* Ring::peek() {
+		unsigned head = *cqHead;
+		if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+			return 0;
+		return &cqes[head & cqMask];
+	}
+
+	void Ring::seen() {
+		__atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+	}
+
+	char* Ring::buffer(unsigned id) {
+		return bufferBase + id * bufferSize;
+	}
+
+	void Ring::recycle(unsigned id) {
+		io_uring_buf* entries = static_cast<io_uring_buf*>(bufferRing);
+		io_uring_buf& entry = entries[bufferTail & (bufferCount - 1)];
+		entry.addr = (unsigned long)buffer(id);
+		entry.len = unsigned(bufferSize);
+		entry.bid = (unsigned short)id;
+		++bufferTail;
+	}
+
+	void Ring::publish() {
+		unsigned short* tail = (unsigned short*)(static_cast<char*>(bufferRing) + bufferRingTail);
+		__atomic_store_n(tail, bufferTail, __ATOMIC_RELEASE);
+	}
+
+#else
+
+	bool Ring::open(unsigned, unsigned, size_t) {
+		return false;
+	}
+
+	bool Ring::probeMultishotRecv() {
+		return false;
+	}
+
+	void Ring::accept(int, uint64_t) {
+		throw HttpError("io_uring not supported");
+	}
+
+	void Ring::receive(int, uint64_t) {
+		throw HttpError("io_uring not supported");
+	}
+
+	void Ring::send(int, const msghdr*, uint64_t) {
+		throw HttpError("io_uring not supported");
+	}
+
+	void Ring::read(int, void*, size_t, uint64_t) {
+		throw HttpError("io_uring not supported");
+	}
+
+	void Ring::poll(int, unsigned, uint64_t) {
+		throw HttpError("io_uring not supported");
+	}
+
+	void Ring::cancel(uint64_t, uint64_t) {
+		throw HttpError("io_uring not supported");
+	}
+
+	void Ring::enter(int) {
+		throw HttpError("io_uring not supported");
+	}
+
+	bool Ring::complete(Event&) {
+		return false;
+	}
+
+	io_uring_sqe* Ring::next() {
+		return 0;
+	}
+
+	io_uring_cqe* Ring::peek() {
+		return 0;
+	}
+
+	void Ring::seen() {
+	}
+
+	void Ring::reap() {
+	}
+
+	char* Ring::buffer(unsigned) {
+		return 0;
+	}
+
+	void Ring::recycle(unsigned) {
+	}
+
+	void Ring::publish() {
+	}
+
+#endif
+
+	void Ring::close() {
+		if (fd != -1)
+			::close(fd);
+		fd = -1;
+		if (sqMap != MAP_FAILED)
+			munmap(sqMap, sqMapSize);
+		if (cqMap != MAP_FAILED)
+			munmap(cqMap, cqMapSize);
+		if (sqeMap != MAP_FAILED)
+			munmap(sqeMap, sqeMapSize);
+		if (bufferRing != MAP_FAILED)
+			munmap(bufferRing, bufferRingSize);
+		sqMap = cqMap = sqeMap = bufferRing = MAP_FAILED;
+	}
+
+} // namespace httplib
@@ -0,0 +1,104 @@
+#ifndef httplib_src_uring_h
+#define httplib_src_uring_h
+
+#include "httplib.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct msghdr;
+
+namespace httplib {
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Just enough io_uring for the reactor, on raw system calls: one submission and completion queue and
+	//-- one ring of provided receive buffers.  Builds without io_uring support in the kernel headers, in which
+	//-- case open() always fails.
+
+	struct Ring {
+		Ring();
+		~Ring();
+
+		// False when the kernel lacks something the reactor relies on: provided buffer rings, extended
+		// enter arguments or multishot receives.
+		bool open(unsigned entries, unsigned buffers, size_t bufferSize);
+
+		// Queue operations; each completion carries the given data back.  accept() and receive() are
+		// multishot and complete once per connection or per buffer of input until they end.
+		void accept(int fd, uint64_t data);
+		void receive(int fd, uint64_t data);
+		void send(int fd, const msghdr* message, uint64_t data);
+		void read(int fd, void* p, size_t size, uint64_t data);
+		void poll(int fd, unsigned events, uint64_t data);
+		void cancel(uint64_t target, uint64_t data);
+
+		// Submits what's queued and waits up to timeout milliseconds (-1 forever) for a completion.
+		void enter(int timeout);
+
+		struct Event {
+			uint64_t data;
+			int result;
+			bool more;			// a multishot operation goes on
+			int buffer;			// provided buffer holding the input, or -1
+		};
+
+		// Takes the next completion, if any.
+		bool complete(Event& event);
+
+		// Received input lives in a provided buffer until it's recycled; recycled buffers go back to the
+		// kernel with the next publish().
+		char* buffer(unsigned id);
+		void recycle(unsigned id);
+		void publish();
+
+		size_t bufferSize;
+
+	private :
+
+		Ring(const Ring&);
+		Ring& operator=(const Ring&);
+
+		void close();
+		bool probeMultishotRecv();
+
+		// A cleared submission entry, submitting queued entries first when the queue is full.
+		io_uring_sqe* next();
+		io_uring_cqe* peek();
+		void seen();
+		void reap();
+
+		int fd;
+
+		void* sqMap;
+		size_t sqMapSize;
+		void* sqeMap;
+		size_t sqeMapSize;
+		void* cqMap;
+		size_t cqMapSize;
+
+		unsigned* sqHead;
+		unsigned* sqTail;
+		unsigned* sqArray;
+		unsigned sqMask;
+		unsigned sqEntries;
+		unsigned sqLocalTail;
+		io_uring_sqe* sqes;
+
+		unsigned* cqHead;
+		unsigned* cqTail;
+		unsigned cqMask;
+		io_uring_cqe* cqes;
+
+		void* bufferRing;
+		size_t bufferRingSize;
+		unsigned bufferCount;
+		unsigned short bufferTail;
+		char* bufferBase;
+
+		// Completions taken off the queue to make room for submissions, handed out by complete() first.
+		vector<Event> reaped;
+		size_t reapedNext;
+	};
+
+}
+
+#endif // httplib_src_uring_h
@@ -8,6 +8,7 @@
 
 #include "uri.h"
 #include "client.h"
+#include "pool.h"
 
 namespace test {
 	using namespace httplib;
@@ -15,7 +16,7 @@ namespace test {
 	struct SyncClientRequest : public ClientRequest {
 
 		SyncClientRequest() { sock = -1; done = false; }
-		~SyncClientRequest() { if (sock != -1) close(sock); }
+		~SyncClientRequest() { disconnect(); }
 
 		virtual void connect(const RequestHeader& header) {
 			Uri uri(header.uri);
@@ -37,6 +38,11 @@ namespace test {
 			freeaddrinfo(addresses);
 		}
 
+		virtual void disconnect() {
+			if (sock != -1) close(sock);
+			sock = -1;
+		}
+
 		virtual void transmit(const iovec* vec, int c) {
 			std::cout << "transmit data ---" << std::endl;
 			for (int i = 0; i < c; ++i)
@@ -48,10 +54,12 @@ namespace test {
 		}
 
 		void read() {
+			done = false;
 			while (!done) {
 				char buf[4096];
 				int w = ::read(sock, buf, 4096);
 				if (w == -1) throw std::runtime_error("Failed to read from string " + string(strerror(errno)));
+				if (w == 0) break;
 				std::cout << "received data ---\n" << string(buf, buf + w) << "---" << std::endl;
 				for (int o = 0; !done && o < w;)
 					o += feed(buf + o, w - o);
@@ -82,14 +90,25 @@ namespace test {
 		bool done;
 	};
 
+	struct SyncClientPool : public ClientPool {
+		virtual ClientRequest* create(const string& scheme, const string& authority) {
+			return new SyncClientRequest();
+		}
+	};
+
 	void clientTest() {
 		RequestHeader hdr;
 		hdr.method = "GET";
 		hdr.uri = "http://jonspencer.ca/";
 
-		SyncClientRequest req;
-		req.request(hdr, string());
-		req.read();
+		// The second request reuses the first connection when the server keeps it alive.
+		SyncClientPool pool;
+		for (int i = 0; i < 2; ++i) {
+			SyncClientRequest* req = static_cast<SyncClientRequest*>(pool.acquire(hdr));
+			req->request(hdr, string());
+			req->read();
+			pool.release(req);
+		}
 	}
 }
 
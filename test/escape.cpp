@@ -0,0 +1,132 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "scan.h"
+
+namespace test {
+	using namespace httplib;
+
+	//---------------------------------------------------------------------------------------------------------
+	//-- Checks every percent-encoding kernel the CPU can run against the scalar reference on pseudo-random
+	//-- input.  Output goes to buffers of exactly the documented size, so a build with -fsanitize=address
+	//-- also catches a kernel writing past them.
+
+	struct Random {
+		Random() : seed(12345) {}
+
+		unsigned next(unsigned n) {
+			seed = seed * 1103515245 + 12345;
+			return (seed >> 8) % n;
+		}
+
+		uint32_t seed;
+	};
+
+	// Plain bytes, bytes that need escaping and escapes, both well-formed and not, mixed the ways that
+	// matter to the vector loops: runs longer than a vector, boundaries inside an escape, short tails.
+	void generate(Random& random, string& input) {
+		static const char mixed[] = "abcXYZ09-_.~/:?#% \x01\x7f\x80\xff";
+		static const char escapes[] = "0123456789abcdefABCDEFg%";
+		size_t length = random.next(8) == 0 ? random.next(2048) : random.next(160);
+		unsigned mode = random.next(4);
+		input.clear();
+		while (input.size() < length) {
+			switch (mode) {
+			case 0 :
+				input += char(random.next(256));
+				break;
+			case 1 :
+				input += mixed[random.next(sizeof(mixed) - 1)];
+				break;
+			case 2 :
+				if (random.next(3) == 0) {
+					input += '%';
+					input += escapes[random.next(sizeof(escapes) - 1)];
+					input += escapes[random.next(sizeof(escapes) - 1)];
+				}
+				else
+					input += char('a' + random.next(26));
+				break;
+			default :
+				input.append(random.next(70), 'a');
+				input += random.next(2) ? "%41" : " ";
+				break;
+			}
+		}
+		input.resize(length);
+	}
+
+	void report(const char* what, const CoderKernel& kernel, const string& input, const char* extra) {
+		printf("%s mismatch in %s for extra \"%s\" and input", what, kernel.name, extra);
+		for (size_t i = 0; i < input.size(); ++i)
+			printf(" %02x", (unsigned char)input[i]);
+		printf("\n");
+	}
+
+	bool same(const char* r, const char* re, const char* k, const char* ke) {
+		if (r == 0 || k == 0)
+			return r == k;
+		return re - r == ke - k && memcmp(r, k, re - r) == 0;
+	}
+
+	int check(long count) {
+		static const char* extras[] = { "", ":?#", ":/?#", "abcdefghij", "%" };
+
+		const CoderKernel* kernels;
+		size_t n = coderKernels(kernels);
+		for (size_t i = 0; i < n; ++i)
+			printf("%s%s", i == 0 ? "kernels: " : ", ", kernels[i].name);
+		printf("\n");
+
+		Random random;
+		string input;
+		long failures = 0;
+		long c = 0;
+		for (; c < count && failures < 10; ++c) {
+			generate(random, input);
+			const char* extra = extras[random.next(5)];
+			const char* b = input.data();
+			const char* e = b + input.size();
+
+			char* reference = new char[3 * input.size()];
+			char* referenceEnd = kernels[0].escape(b, e, extra, reference);
+			for (size_t i = 1; i < n; ++i) {
+				char* out = new char[3 * input.size()];
+				if (!same(reference, referenceEnd, out, kernels[i].escape(b, e, extra, out))) {
+					report("escape", kernels[i], input, extra);
+					++failures;
+				}
+				delete[] out;
+			}
+
+			referenceEnd = kernels[0].unescape(b, e, reference);
+			for (size_t i = 1; i < n; ++i) {
+				char* out = new char[input.size()];
+				char* end = kernels[i].unescape(b, e, out);
+				if (!same(referenceEnd == 0 ? 0 : reference, referenceEnd, end == 0 ? 0 : out, end)) {
+					report("unescape", kernels[i], input, "");
+					++failures;
+				}
+				delete[] out;
+			}
+			delete[] reference;
+		}
+
+		printf("%ld inputs, %ld mismatches\n", c, failures);
+		return failures == 0 ? 0 : 1;
+	}
+
+}
+
+int main(int ac, char **av) {
+	try {
+		return test::check(ac > 1 ? atol(av[1]) : 1000000);
+	}
+	catch (std::runtime_error& err) {
+		std::cerr << err.what() << std::endl;
+		return 10;
+	}
+}
@@ -37,7 +37,7 @@ namespace test {
 			r.code = 200;
 			r.headers.push_back(HttpHeader("Content-Type", "text/plain"));
 			response(r, "Hello");
-			done = true;
+			done = shouldClose();
 		}
 
 		virtual void transmit(const iovec* vec, int c) {
@@ -55,9 +55,10 @@ namespace test {
 				char buf[4096];
 				int w = ::read(sock, buf, 4096);
 				if (w == -1) throw std::runtime_error("Failed to read from string " + string(strerror(errno)));
+				if (w == 0) break;
 				std::cout << "received data ---\n" << string(buf, buf + w) << "---" << std::endl;
 				for (int o = 0; !done && o < w;)
-					o -= feed(buf + o, w - o);
+					o += feed(buf + o, w - o);
 			}
 		}
 